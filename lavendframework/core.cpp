@@ -22,6 +22,9 @@ void Core::run()
 	// update our _deltaTime
 	_calculateDeltaTime();
 
+	// work out how many fixed ticks this frame runs
+	Singleton<FixedStep>::instance()->advance(_deltaTime);
+
 	// Update Input singleton instance
 	Singleton<Input>::instance()->updateInput(_renderer.window());
 
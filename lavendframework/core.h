@@ -10,6 +10,7 @@
 #include <lavendframework/renderer.h>
 #include <lavendframework/input.h>
 #include <lavendframework/entity.h>
+#include <lavendframework/fixedstep.h>
 
 /// @brief The Core class handles updating and rendering of your Entities.
 class Core
@@ -29,6 +30,9 @@ public:
 	/// double internally, cast to float. glm and OpenGL expect floats.
 	/// @return float deltaTime
 	float deltaTime() { return (float)_deltaTime; };
+	/// @brief get the fixed timestep scheduler, every run() advances it by deltaTime
+	/// @return FixedStep* the scheduler Entities see through fixedStep()
+	FixedStep* fixedStep() { return Singleton<FixedStep>::instance(); };
 	/// @brief prints the framerate to output every second
 	/// @param numsecs print framerate every nth second.
 	/// @return void
@@ -3,6 +3,7 @@
 Entity::Entity()
 {
 	_input = Singleton<Input>::instance();
+	_fixedStep = Singleton<FixedStep>::instance();
 }
 
 Entity::~Entity()
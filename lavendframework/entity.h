@@ -3,6 +3,7 @@
 
 #include <lavendframework/input.h>
 #include <lavendframework/singleton.h>
+#include <lavendframework/fixedstep.h>
 
 class Entity
 {
@@ -13,9 +14,13 @@ public:
 	/// @brief get a pointer to the Input
 	/// @return Input* a pointer to the Input
 	Input* input() { return _input; };
+	/// @brief get a pointer to the fixed timestep scheduler the Core advances every frame
+	/// @return FixedStep* a pointer to the FixedStep
+	FixedStep* fixedStep() { return _fixedStep; };
 
 private:
 	Input* _input; ///< @brief the Input instance
+	FixedStep* _fixedStep; ///< @brief the FixedStep instance
 };
 
 #endif
\ No newline at end of file
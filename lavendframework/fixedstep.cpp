@@ -0,0 +1,51 @@
+/**
+ * This file is part of RT2D, a 2D OpenGL framework.
+ */
+
+#include <lavendframework/fixedstep.h>
+
+FixedStep::FixedStep()
+{
+	_tickTime = 1.0 / 60.0;
+	_maxCatchUp = 4;
+	_dropped = 0;
+	reset();
+}
+
+FixedStep::~FixedStep()
+{
+
+}
+
+void FixedStep::tickRate(double hz)
+{
+	if (hz > 0) {
+		_tickTime = 1.0 / hz;
+	}
+}
+
+void FixedStep::advance(double deltaTime)
+{
+	if (deltaTime > 0) {
+		_accumulator += deltaTime;
+	}
+	_ticks = 0;
+	while (_accumulator >= _tickTime && _ticks < _maxCatchUp) {
+		_accumulator -= _tickTime;
+		_ticks++;
+	}
+	// too far behind to catch up: drop the rest, or every next frame falls further behind
+	if (_accumulator >= _tickTime) {
+		unsigned int behind = (unsigned int)(_accumulator / _tickTime);
+		_dropped += behind;
+		_accumulator -= behind * _tickTime;
+	}
+	_alpha = (float)(_accumulator / _tickTime);
+}
+
+void FixedStep::reset()
+{
+	_accumulator = 0;
+	_ticks = 0;
+	_alpha = 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file fixedstep.h
+ *
+ * @brief The FixedStep header file.
+ *
+ * This file is part of RT2D, a 2D OpenGL framework.
+ */
+
+#ifndef FIXEDSTEP_H
+#define FIXEDSTEP_H
+
+/// @brief The FixedStep class turns the time between frames into a whole number of fixed ticks.
+///
+/// The time of every frame goes into an accumulator and every tickTime() of it
+/// is one tick, so the game runs at the tick rate whatever the frame rate is: a
+/// fast machine runs a tick every few frames, a slow one several ticks per
+/// frame. No more than maxCatchUp() ticks run in one frame; when a frame takes
+/// longer than that, the rest is dropped instead of making the next frame even
+/// slower. alpha() is how far the frame is between the last tick and the next,
+/// to interpolate what moves when rendering.
+class FixedStep
+{
+public:
+	FixedStep(); ///< @brief Constructor of the FixedStep
+	virtual ~FixedStep(); ///< @brief Destructor of the FixedStep
+
+	/// @brief Set the number of ticks per second
+	/// @param hz Ticks per second
+	/// @return void
+	void tickRate(double hz);
+	/// @brief Get the number of ticks per second
+	/// @return double
+	double tickRate() { return 1.0 / _tickTime; };
+	/// @brief Seconds per tick
+	/// @return double
+	double tickTime() { return _tickTime; };
+	/// @brief Set the most ticks one frame may run
+	/// @param n Ticks, at least 1
+	/// @return void
+	void maxCatchUp(int n) { _maxCatchUp = (n < 1) ? 1 : n; };
+	/// @brief Get the most ticks one frame may run
+	/// @return int
+	int maxCatchUp() { return _maxCatchUp; };
+
+	/// @brief Add the time of a frame and work out how many ticks it runs
+	/// @param deltaTime Seconds since the last frame
+	/// @return void
+	void advance(double deltaTime);
+	/// @brief Forget the time that wasn't ticked yet
+	/// @return void
+	void reset();
+
+	/// @brief Ticks to run this frame
+	/// @return int
+	int ticks() { return _ticks; };
+	/// @brief Where the frame is between the last tick (0) and the next (1)
+	/// @return float
+	float alpha() { return _alpha; };
+	/// @brief Ticks dropped because a frame took longer than maxCatchUp() ticks
+	/// @return unsigned int
+	unsigned int dropped() { return _dropped; };
+
+private:
+	double _tickTime; ///< @brief Seconds per tick
+	double _accumulator; ///< @brief Time not ticked yet
+	int _maxCatchUp; ///< @brief Most ticks per frame
+	int _ticks; ///< @brief Ticks to run this frame
+	float _alpha; ///< @brief Where the frame is between two ticks
+	unsigned int _dropped; ///< @brief Ticks dropped so far
+};
+
+#endif /* FIXEDSTEP_H */
@@ -0,0 +1,145 @@
+#include "adpcm.h"
+
+#define IMA_MAX_CHANNELS 8
+
+static const int indexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int stepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static inline int clampIndex(int index)
+{
+    return index < 0 ? 0 : (index > 88 ? 88 : index);
+}
+
+static inline short decodeNibble(int nibble, int& predictor, int& index)
+{
+    int step = stepTable[index];
+    int diff = step >> 3;
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+    if (nibble & 8) {
+        predictor -= diff;
+    } else {
+        predictor += diff;
+    }
+    if (predictor > 32767) predictor = 32767;
+    if (predictor < -32768) predictor = -32768;
+    index = clampIndex(index + indexTable[nibble]);
+    return (short)predictor;
+}
+
+static inline int encodeNibble(int sample, int& predictor, int& index)
+{
+    int step = stepTable[index];
+    int diff = sample - predictor;
+    int nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) { nibble |= 4; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 2; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 1; }
+
+    // track the decoder exactly, so errors don't accumulate
+    decodeNibble(nibble, predictor, index);
+    return nibble;
+}
+
+int imaSamplesPerBlock(int blockAlign, int channels)
+{
+    return (blockAlign - 4 * channels) * 2 / channels + 1;
+}
+
+int imaDecodeBlock(const unsigned char* block, int bytes, int channels, short* out)
+{
+    int headerBytes = 4 * channels;
+    if (channels < 1 || channels > IMA_MAX_CHANNELS || bytes < headerBytes) {
+        return 0;
+    }
+
+    int predictor[IMA_MAX_CHANNELS];
+    int index[IMA_MAX_CHANNELS];
+    for (int c = 0; c < channels; c++) {
+        const unsigned char* h = block + c * 4;
+        predictor[c] = (short)(h[0] | (h[1] << 8));
+        index[c] = clampIndex(h[2]);
+        out[c] = (short)predictor[c];
+    }
+
+    // after the headers: 4 bytes (8 samples) of each channel in turn
+    const unsigned char* data = block + headerBytes;
+    int groups = (bytes - headerBytes) / (4 * channels);
+    for (int g = 0; g < groups; g++) {
+        for (int c = 0; c < channels; c++) {
+            const unsigned char* p = data + (g * channels + c) * 4;
+            for (int b = 0; b < 4; b++) {
+                int frame = 1 + g * 8 + b * 2;
+                out[frame * channels + c] = decodeNibble(p[b] & 0x0F, predictor[c], index[c]);
+                out[(frame + 1) * channels + c] = decodeNibble(p[b] >> 4, predictor[c], index[c]);
+            }
+        }
+    }
+    return 1 + groups * 8;
+}
+
+std::vector<unsigned char> imaEncode(const short* pcm, size_t frames, int channels, int blockAlign)
+{
+    std::vector<unsigned char> out;
+    if (channels < 1 || channels > IMA_MAX_CHANNELS || frames == 0) {
+        return out;
+    }
+
+    int samplesPerBlock = imaSamplesPerBlock(blockAlign, channels);
+    size_t blocks = (frames + samplesPerBlock - 1) / samplesPerBlock;
+    out.resize(blocks * blockAlign, 0);
+
+    int index[IMA_MAX_CHANNELS] = { 0 };
+    int groups = (samplesPerBlock - 1) / 8;
+    for (size_t b = 0; b < blocks; b++) {
+        unsigned char* block = &out[b * blockAlign];
+        size_t first = b * samplesPerBlock;
+
+        int predictor[IMA_MAX_CHANNELS];
+        for (int c = 0; c < channels; c++) {
+            short s = pcm[first * channels + c];
+            predictor[c] = s;
+            block[c * 4 + 0] = (unsigned char)(s & 0xFF);
+            block[c * 4 + 1] = (unsigned char)((s >> 8) & 0xFF);
+            block[c * 4 + 2] = (unsigned char)index[c];
+            block[c * 4 + 3] = 0;
+        }
+
+        unsigned char* data = block + 4 * channels;
+        for (int g = 0; g < groups; g++) {
+            for (int c = 0; c < channels; c++) {
+                unsigned char* p = data + (g * channels + c) * 4;
+                for (int i = 0; i < 4; i++) {
+                    size_t frame = first + 1 + g * 8 + i * 2;
+                    int lo = frame < frames ? pcm[frame * channels + c] : 0;
+                    int hi = frame + 1 < frames ? pcm[(frame + 1) * channels + c] : 0;
+                    int a = encodeNibble(lo, predictor[c], index[c]);
+                    int n = encodeNibble(hi, predictor[c], index[c]);
+                    p[i] = (unsigned char)(a | (n << 4));
+                }
+            }
+        }
+    }
+    return out;
+}
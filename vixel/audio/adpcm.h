@@ -0,0 +1,24 @@
+#ifndef ADPCM_H_
+#define ADPCM_H_
+
+#include <vector>
+#include <stddef.h>
+
+/*
+ * IMA-ADPCM as stored in WAVE files (format tag 0x11): 4 bits per sample,
+ * a quarter of 16-bit PCM. Every block starts with a header per channel
+ * (first sample + step index), so blocks decode independently.
+ */
+
+// number of sample frames in one block of 'blockAlign' bytes
+int imaSamplesPerBlock(int blockAlign, int channels);
+
+// Decode one block (may be a short last block of 'bytes' < blockAlign).
+// Writes interleaved 16-bit samples to 'out' and returns the number of frames.
+int imaDecodeBlock(const unsigned char* block, int bytes, int channels, short* out);
+
+// Encode interleaved 16-bit PCM into blocks of 'blockAlign' bytes.
+// The last block is padded with silence.
+std::vector<unsigned char> imaEncode(const short* pcm, size_t frames, int channels, int blockAlign);
+
+#endif /* ADPCM_H_ */
@@ -1,9 +1,194 @@
 #include <iostream>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <vector>
 
 #include "audio.h"
+#include "audiobackend.h"
+#include "mixer.h"
+#include "streamingsound.h"
+#include "commandqueue.h"
 
-ALCdevice* Audio::device = alcOpenDevice( alcGetString(nullptr, ALC_DEFAULT_DEVICE_SPECIFIER) );
-ALCcontext* Audio::context = alcCreateContext(device, nullptr);
+/*
+ * One request from the game thread to the audio thread
+ */
+struct AudioCommand
+{
+    enum Type {
+        LOAD_SAMPLE, SAMPLE_GAIN, SAMPLE_PRIORITY, PLAY, STOP_VOICE, STOP_SAMPLE,
+        LOAD_STREAM, PLAY_STREAM, PAUSE_STREAM, STOP_STREAM, STREAM_GAIN, STREAM_LOOP,
+        LISTENER, VOLUME, MEMORY_REPORT
+    };
+    Type type;
+    int id;
+    int token;
+    float x;
+    float y;
+    float value;
+    const char* path;
+};
+
+/*
+ * State the audio thread publishes for the game thread (seqlock)
+ */
+struct AudioSnapshot
+{
+    std::atomic<unsigned int> sequence;
+    std::atomic<int> streams[Audio::MAX_STREAMS];
+    std::atomic<int> playingVoices;
+};
+
+// shared between the threads
+static CommandQueue<AudioCommand, 1024> commands;
+static AudioSnapshot snapshot;
+static std::atomic<bool> running(false);
+static std::thread audioThread;
+static std::promise<bool> opened; // the audio thread tells init() if its backend opened
+
+// game thread only
+static std::deque<std::string> sampleNames; // a deque never moves its strings
+static std::deque<std::string> streamNames;
+static int nextToken = 0;
+
+// audio thread only
+static AudioBackend* backend = nullptr;
+static Mixer* mixer = nullptr;
+static StreamingSound* streams[Audio::MAX_STREAMS];
+static const int TOKEN_SLOTS = 256;
+static int tokenIds[TOKEN_SLOTS];
+static int tokenVoices[TOKEN_SLOTS];
+
+// game thread: check a stream handle before it goes to the audio thread
+static bool validStream(int stream)
+{
+    return stream >= 0 && stream < (int)streamNames.size();
+}
+
+static void send(AudioCommand::Type type, int id, float value = 0, float x = 0, float y = 0)
+{
+    AudioCommand c;
+    c.type = type;
+    c.id = id;
+    c.token = -1;
+    c.x = x;
+    c.y = y;
+    c.value = value;
+    c.path = nullptr;
+    if (!running) {
+        return;
+    }
+    if (!commands.push(c)) {
+        std::cerr << "Audio command queue full, dropping command " << type << std::endl;
+    }
+}
+
+// the stream behind a handle, nullptr when there's none (a failed or dropped load)
+static StreamingSound* stream(int id)
+{
+    if (id < 0 || id >= Audio::MAX_STREAMS) {
+        return nullptr;
+    }
+    return streams[id];
+}
+
+static void execute(const AudioCommand& c)
+{
+    switch (c.type) {
+        case AudioCommand::LOAD_SAMPLE:
+            mixer->load(c.path);
+            break;
+        case AudioCommand::SAMPLE_GAIN:
+            mixer->gain(c.id, c.value);
+            break;
+        case AudioCommand::SAMPLE_PRIORITY:
+            mixer->priority(c.id, int(c.value));
+            break;
+        case AudioCommand::PLAY: {
+            int slot = c.token % TOKEN_SLOTS;
+            tokenIds[slot] = c.token;
+            tokenVoices[slot] = mixer->play(c.id, c.x, c.y);
+            break;
+        }
+        case AudioCommand::STOP_VOICE: {
+            int slot = c.id % TOKEN_SLOTS;
+            if (tokenIds[slot] == c.id) {
+                mixer->stopVoice(tokenVoices[slot]);
+            }
+            break;
+        }
+        case AudioCommand::STOP_SAMPLE:
+            mixer->stop(c.id);
+            break;
+        case AudioCommand::LOAD_STREAM:
+            if (c.id >= 0 && c.id < Audio::MAX_STREAMS) {
+                delete streams[c.id];
+                streams[c.id] = new StreamingSound(c.path);
+            }
+            break;
+        case AudioCommand::PLAY_STREAM:
+            if (StreamingSound* s = stream(c.id)) {
+                s->play();
+            }
+            break;
+        case AudioCommand::PAUSE_STREAM:
+            if (StreamingSound* s = stream(c.id)) {
+                s->pause();
+            }
+            break;
+        case AudioCommand::STOP_STREAM:
+            if (StreamingSound* s = stream(c.id)) {
+                s->stop();
+            }
+            break;
+        case AudioCommand::STREAM_GAIN:
+            if (StreamingSound* s = stream(c.id)) {
+                s->gain(c.value);
+            }
+            break;
+        case AudioCommand::STREAM_LOOP:
+            if (StreamingSound* s = stream(c.id)) {
+                s->loop(c.value != 0);
+            }
+            break;
+        case AudioCommand::LISTENER:
+            mixer->listener(c.x, c.y);
+            break;
+        case AudioCommand::VOLUME:
+            alListenerf(AL_GAIN, c.value);
+            break;
+        case AudioCommand::MEMORY_REPORT:
+            mixer->memoryReport();
+            break;
+    }
+}
+
+// game thread, once the audio thread is gone: forget everything the next one
+// wouldn't know about. The commands first, loads point into the names
+static void forget()
+{
+    AudioCommand c;
+    while (commands.pop(c)) {
+    }
+    sampleNames.clear();
+    streamNames.clear();
+    nextToken = 0;
+}
+
+static void publish()
+{
+    unsigned int seq = snapshot.sequence.load(std::memory_order_relaxed);
+    snapshot.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < Audio::MAX_STREAMS; i++) {
+        int state = streams[i] ? streams[i]->state() : Sound::STATE_STOPPED;
+        snapshot.streams[i].store(state, std::memory_order_relaxed);
+    }
+    snapshot.playingVoices.store(mixer ? mixer->playingVoices() : 0, std::memory_order_relaxed);
+    snapshot.sequence.store(seq + 2, std::memory_order_release);
+}
 
 Audio::Audio()
 {
@@ -15,37 +200,266 @@ Audio::~Audio()
 
 }
 
-void Audio::init()
+bool Audio::init(Backend which)
 {
-    if (Audio::device) {
-        alcCloseDevice(Audio::device);
+    if (running) {
+        return true;
     }
-    if (Audio::context) {
-        alcDestroyContext(Audio::context);
+    if (audioThread.joinable()) {
+        audioThread.join(); // left early, its backend didn't open
     }
-
-    const ALCchar *defaultDeviceName = alcGetString(nullptr, ALC_DEFAULT_DEVICE_SPECIFIER);
-    Audio::device = alcOpenDevice(defaultDeviceName);
-    if (Audio::device) {
-        std::cout << "Created audio device: " << defaultDeviceName << std::endl;
+    forget();
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        snapshot.streams[i].store(Sound::STATE_STOPPED);
     }
-    std::cout << "Device: " << alcGetString(device, ALC_DEVICE_SPECIFIER) << std::endl;
-    alGetError();
+    snapshot.playingVoices.store(0);
+
+    opened = std::promise<bool>();
+    std::future<bool> result = opened.get_future();
+    running = true;
+    audioThread = std::thread(Audio::run, which);
+    // wait for the backend, so the game knows if anything is listening
+    return result.get();
+}
 
-    Audio::context = alcCreateContext(Audio::device, nullptr);
-    if (Audio::context) {
-        std::cout << "Created audio context." << std::endl;
+void Audio::shutdown()
+{
+    running = false;
+    if (audioThread.joinable()) {
+        audioThread.join();
     }
+    forget();
+}
 
-    if (!alcMakeContextCurrent(Audio::context)) {
-        std::cerr << "Failed to make default audio context current." << std::endl;
-    } else {
-        std::cout << "Created context as current" << std::endl;
+void Audio::run(Backend which)
+{
+    if (which == BACKEND_DEVICE) {
+        backend = new OpenALBackend();
+        if (!backend->open()) {
+            // no sound hardware (CI, servers): mix in memory instead
+            delete backend;
+            which = BACKEND_LOOPBACK;
+        }
     }
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        streams[i] = nullptr;
+    }
+    if (which == BACKEND_LOOPBACK) {
+        backend = new LoopbackBackend();
+        if (!backend->open()) {
+            // nothing to play on: stop here, every call is ignored from now on
+            std::cerr << "No audio backend, sound is off." << std::endl;
+            delete backend;
+            backend = nullptr;
+            publish();
+            running = false;
+            opened.set_value(false);
+            return;
+        }
+    }
+    std::cout << "Audio backend: " << backend->name() << std::endl;
 
     ALfloat listenerOri[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f };
     /* set orientation */
     alListener3f(AL_POSITION, 0, 0, 1.0f);
     alListener3f(AL_VELOCITY, 0, 0, 0);
     alListenerfv(AL_ORIENTATION, listenerOri);
+
+    mixer = new Mixer(16);
+    for (int i = 0; i < TOKEN_SLOTS; i++) {
+        tokenIds[i] = -1;
+        tokenVoices[i] = -1;
+    }
+
+    opened.set_value(true);
+
+    AudioCommand c;
+    while (running) {
+        while (commands.pop(c)) {
+            execute(c);
+        }
+        for (int i = 0; i < MAX_STREAMS; i++) {
+            if (streams[i]) {
+                streams[i]->update();
+            }
+        }
+        backend->update();
+        publish();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        delete streams[i];
+        streams[i] = nullptr;
+    }
+    delete mixer;
+    mixer = nullptr;
+
+    backend->close();
+    delete backend;
+    backend = nullptr;
+}
+
+void Audio::volume(float vol)
+{
+    send(AudioCommand::VOLUME, 0, vol);
+}
+
+void Audio::listener(float x, float y)
+{
+    send(AudioCommand::LISTENER, 0, 0, x, y);
+}
+
+int Audio::loadSample(std::string filename)
+{
+    if (!running) {
+        return -1;
+    }
+    // same handle the Mixer will hand out on the audio thread
+    for (size_t i = 0; i < sampleNames.size(); i++) {
+        if (sampleNames[i] == filename) {
+            return (int)i;
+        }
+    }
+    sampleNames.push_back(filename);
+
+    AudioCommand c;
+    c.type = AudioCommand::LOAD_SAMPLE;
+    c.id = (int)sampleNames.size() - 1;
+    c.path = sampleNames.back().c_str();
+    if (!commands.push(c)) {
+        // the Mixer never sees it, later samples would get the wrong handles
+        std::cerr << "Audio command queue full, unable to load: " << filename << std::endl;
+        sampleNames.pop_back();
+        return -1;
+    }
+    return c.id;
+}
+
+void Audio::sampleGain(int sample, float g)
+{
+    send(AudioCommand::SAMPLE_GAIN, sample, g);
+}
+
+void Audio::samplePriority(int sample, int p)
+{
+    send(AudioCommand::SAMPLE_PRIORITY, sample, float(p));
+}
+
+int Audio::play(int sample, float x, float y)
+{
+    if (!running) {
+        return -1;
+    }
+    AudioCommand c;
+    c.type = AudioCommand::PLAY;
+    c.id = sample;
+    c.token = nextToken;
+    c.x = x;
+    c.y = y;
+    c.value = 0;
+    c.path = nullptr;
+    if (!commands.push(c)) {
+        std::cerr << "Audio command queue full, dropping command " << c.type << std::endl;
+        return -1;
+    }
+    nextToken = (nextToken + 1) & 0x7FFFFFFF;
+    return c.token;
+}
+
+void Audio::stopVoice(int token)
+{
+    if (token >= 0) {
+        send(AudioCommand::STOP_VOICE, token);
+    }
+}
+
+void Audio::stopSample(int sample)
+{
+    send(AudioCommand::STOP_SAMPLE, sample);
+}
+
+void Audio::memoryReport()
+{
+    send(AudioCommand::MEMORY_REPORT, 0);
+}
+
+int Audio::loadStream(std::string filename)
+{
+    if (!running) {
+        return -1;
+    }
+    if ((int)streamNames.size() >= MAX_STREAMS) {
+        std::cerr << "Too many streams, unable to load: " << filename << std::endl;
+        return -1;
+    }
+    streamNames.push_back(filename);
+
+    AudioCommand c;
+    c.type = AudioCommand::LOAD_STREAM;
+    c.id = (int)streamNames.size() - 1;
+    c.path = streamNames.back().c_str();
+    if (!commands.push(c)) {
+        std::cerr << "Audio command queue full, unable to load: " << filename << std::endl;
+        streamNames.pop_back();
+        return -1;
+    }
+    return c.id;
+}
+
+void Audio::playStream(int stream)
+{
+    if (validStream(stream)) {
+        send(AudioCommand::PLAY_STREAM, stream);
+    }
+}
+
+void Audio::pauseStream(int stream)
+{
+    if (validStream(stream)) {
+        send(AudioCommand::PAUSE_STREAM, stream);
+    }
+}
+
+void Audio::stopStream(int stream)
+{
+    if (validStream(stream)) {
+        send(AudioCommand::STOP_STREAM, stream);
+    }
+}
+
+void Audio::streamGain(int stream, float g)
+{
+    if (validStream(stream)) {
+        send(AudioCommand::STREAM_GAIN, stream, g);
+    }
+}
+
+void Audio::loopStream(int stream, bool l)
+{
+    if (validStream(stream)) {
+        send(AudioCommand::STREAM_LOOP, stream, l ? 1.0f : 0.0f);
+    }
+}
+
+Sound::State Audio::streamState(int stream)
+{
+    if (stream < 0 || stream >= MAX_STREAMS) {
+        return Sound::STATE_STOPPED;
+    }
+    return Sound::State(snapshot.streams[stream].load(std::memory_order_acquire));
+}
+
+int Audio::playingVoices()
+{
+    // retry while the audio thread is in the middle of publishing
+    unsigned int before, after;
+    int voices;
+    do {
+        before = snapshot.sequence.load(std::memory_order_acquire);
+        voices = snapshot.playingVoices.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = snapshot.sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return voices;
 }
@@ -1,20 +1,62 @@
 #ifndef AUDIO_H_
 #define AUDIO_H_
 
+#include <string>
 #include <AL/al.h>
 #include <AL/alc.h>
 
+#include "sound.h"
+
+/*
+ * The audio subsystem. init() starts a dedicated audio thread that owns the
+ * backend, the Mixer for sound effects and the StreamingSounds for music.
+ * Everything below only pushes a command on a lock-free queue, or reads the
+ * state the audio thread last published, so the game thread never calls
+ * into OpenAL. All calls must come from the same (game) thread.
+ */
 class Audio {
     public:
         Audio();
         virtual ~Audio();
-        static void init();
 
-		static void volume(float vol) { alListenerf(AL_GAIN, vol); }
+        enum Backend {BACKEND_DEVICE, BACKEND_LOOPBACK};
+
+        // BACKEND_DEVICE falls back to the loopback mixer when there's no sound card.
+        // Returns false when no backend opened: the audio thread is gone and every call is ignored
+        static bool init(Backend backend = BACKEND_DEVICE);
+        // stops the audio thread, every handle it handed out is gone, also for a next init()
+        static void shutdown();
+
+        static void volume(float vol);
+        static void listener(float x, float y);
+
+        // sound effects, -1 when the command queue is full
+        static int loadSample(std::string filename);
+        static void sampleGain(int sample, float g);
+        static void samplePriority(int sample, int p);
+        // returns a token for stopVoice(), -1 when the command queue is full
+        static int play(int sample, float x = 0, float y = 0);
+        static void stopVoice(int token);
+        static void stopSample(int sample);
+        // print sample memory use (from the audio thread, once it gets there)
+        static void memoryReport();
+
+        // music, -1 when there are MAX_STREAMS already or the command queue is full
+        static int loadStream(std::string filename);
+        static void playStream(int stream);
+        static void pauseStream(int stream);
+        static void stopStream(int stream);
+        static void streamGain(int stream, float g);
+        static void loopStream(int stream, bool l);
+
+        // state published by the audio thread
+        static Sound::State streamState(int stream);
+        static int playingVoices();
+
+        static const int MAX_STREAMS = 8;
 
-    protected:
-        static ALCdevice *device;
-        static ALCcontext *context;
+    private:
+        static void run(Backend backend);
 };
 
 #endif /* AUDIO_H_ */
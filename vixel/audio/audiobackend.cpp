@@ -0,0 +1,158 @@
+#include <iostream>
+#include <chrono>
+#include "audiobackend.h"
+
+static double wallClock()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AudioBackend::AudioBackend()
+{
+    _device = nullptr;
+    _context = nullptr;
+}
+
+AudioBackend::~AudioBackend()
+{
+    this->close();
+}
+
+bool AudioBackend::makeCurrent()
+{
+    _context = alcCreateContext(_device, nullptr);
+    if (!_context) {
+        std::cerr << "Failed to create audio context." << std::endl;
+        return false;
+    }
+    if (!alcMakeContextCurrent(_context)) {
+        std::cerr << "Failed to make default audio context current." << std::endl;
+        return false;
+    }
+    std::cout << "Created context as current" << std::endl;
+    return true;
+}
+
+void AudioBackend::close()
+{
+    // the context has to go before the device it lives on
+    if (_context) {
+        if (alcGetCurrentContext() == _context) {
+            alcMakeContextCurrent(nullptr);
+        }
+        alcDestroyContext(_context);
+        _context = nullptr;
+    }
+    if (_device) {
+        alcCloseDevice(_device);
+        _device = nullptr;
+    }
+}
+
+bool OpenALBackend::open()
+{
+    const ALCchar *defaultDeviceName = alcGetString(nullptr, ALC_DEFAULT_DEVICE_SPECIFIER);
+    _device = alcOpenDevice(defaultDeviceName);
+    if (!_device) {
+        std::cerr << "Unable to open audio device." << std::endl;
+        return false;
+    }
+    std::cout << "Created audio device: " << alcGetString(_device, ALC_DEVICE_SPECIFIER) << std::endl;
+    alGetError();
+
+    if (!makeCurrent()) {
+        this->close();
+        return false;
+    }
+    return true;
+}
+
+LoopbackBackend::LoopbackBackend(int frequency, ALCenum sampleType)
+{
+    _frequency = frequency;
+    _sampleType = sampleType;
+    _lastUpdate = 0;
+    _pending = 0;
+    _loopbackOpenDevice = nullptr;
+    _isRenderFormatSupported = nullptr;
+    _renderSamples = nullptr;
+}
+
+bool LoopbackBackend::open()
+{
+    if (!alcIsExtensionPresent(nullptr, "ALC_SOFT_loopback")) {
+        std::cerr << "ALC_SOFT_loopback not supported." << std::endl;
+        return false;
+    }
+    _loopbackOpenDevice = (LPALCLOOPBACKOPENDEVICESOFT) alcGetProcAddress(nullptr, "alcLoopbackOpenDeviceSOFT");
+    _isRenderFormatSupported = (LPALCISRENDERFORMATSUPPORTEDSOFT) alcGetProcAddress(nullptr, "alcIsRenderFormatSupportedSOFT");
+    _renderSamples = (LPALCRENDERSAMPLESSOFT) alcGetProcAddress(nullptr, "alcRenderSamplesSOFT");
+    if (!_loopbackOpenDevice || !_isRenderFormatSupported || !_renderSamples) {
+        std::cerr << "ALC_SOFT_loopback functions missing." << std::endl;
+        return false;
+    }
+
+    _device = _loopbackOpenDevice(nullptr);
+    if (!_device) {
+        std::cerr << "Unable to open loopback device." << std::endl;
+        return false;
+    }
+    if (!_isRenderFormatSupported(_device, _frequency, ALC_STEREO_SOFT, _sampleType)) {
+        std::cerr << "Loopback render format not supported." << std::endl;
+        this->close();
+        return false;
+    }
+
+    ALCint attrs[] = {
+        ALC_FORMAT_CHANNELS_SOFT, ALC_STEREO_SOFT,
+        ALC_FORMAT_TYPE_SOFT, ALCint(_sampleType),
+        ALC_FREQUENCY, _frequency,
+        0
+    };
+    _context = alcCreateContext(_device, attrs);
+    if (!_context || !alcMakeContextCurrent(_context)) {
+        std::cerr << "Failed to create loopback audio context." << std::endl;
+        this->close();
+        return false;
+    }
+    std::cout << "Created loopback audio device (" << _frequency << "Hz)" << std::endl;
+
+    _lastUpdate = wallClock();
+    return true;
+}
+
+int LoopbackBackend::frameSize()
+{
+    int bytes = 4;
+    if (_sampleType == ALC_SHORT_SOFT || _sampleType == ALC_UNSIGNED_SHORT_SOFT) {
+        bytes = 2;
+    } else if (_sampleType == ALC_BYTE_SOFT || _sampleType == ALC_UNSIGNED_BYTE_SOFT) {
+        bytes = 1;
+    }
+    return bytes * 2; // stereo
+}
+
+void LoopbackBackend::render(int frames)
+{
+    if (!_device || frames <= 0) {
+        return;
+    }
+    _output.resize(size_t(frames) * frameSize());
+    _renderSamples(_device, &_output[0], frames);
+}
+
+void LoopbackBackend::update()
+{
+    // advance the mixer as fast as a real device would
+    double now = wallClock();
+    _pending += (now - _lastUpdate) * _frequency;
+    _lastUpdate = now;
+    if (_pending > _frequency / 4) {
+        _pending = _frequency / 4; // don't try to catch up after a long stall
+    }
+    int frames = int(_pending);
+    if (frames > 0) {
+        render(frames);
+        _pending -= frames;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef AUDIOBACKEND_H_
+#define AUDIOBACKEND_H_
+
+#include <vector>
+#include <AL/al.h>
+#include <AL/alc.h>
+#include <AL/alext.h>
+
+/*
+ * Where the mixed audio goes. open() creates an AL context and makes it
+ * current on the calling thread, so the Mixer and StreamingSounds work the
+ * same on top of every backend.
+ */
+class AudioBackend
+{
+public:
+    AudioBackend();
+    virtual ~AudioBackend();
+
+    virtual bool open() = 0;
+    virtual void close();
+    // called by the audio thread every iteration
+    virtual void update() { }
+    virtual const char* name() = 0;
+
+protected:
+    ALCdevice* _device;
+    ALCcontext* _context;
+    bool makeCurrent();
+};
+
+/*
+ * The default sound card
+ */
+class OpenALBackend : public AudioBackend
+{
+public:
+    virtual bool open();
+    virtual const char* name() { return "OpenAL device"; }
+};
+
+/*
+ * OpenAL Soft's software mixer rendering into memory (ALC_SOFT_loopback).
+ * Works without sound hardware. render() mixes a fixed number of frames, so
+ * output is reproducible; update() keeps pace with the wall clock when this
+ * runs inside the game.
+ */
+class LoopbackBackend : public AudioBackend
+{
+public:
+    LoopbackBackend(int frequency = 44100, ALCenum sampleType = ALC_FLOAT_SOFT);
+
+    virtual bool open();
+    virtual void update();
+    virtual const char* name() { return "OpenAL Soft loopback"; }
+
+    // mix 'frames' stereo frames; the result is in output()
+    void render(int frames);
+    const std::vector<unsigned char>& output() { return _output; }
+    int frequency() { return _frequency; }
+    int frameSize();
+
+private:
+    int _frequency;
+    ALCenum _sampleType;
+    std::vector<unsigned char> _output;
+    double _lastUpdate;
+    double _pending;
+    LPALCLOOPBACKOPENDEVICESOFT _loopbackOpenDevice;
+    LPALCISRENDERFORMATSUPPORTEDSOFT _isRenderFormatSupported;
+    LPALCRENDERSAMPLESSOFT _renderSamples;
+};
+
+#endif /* AUDIOBACKEND_H_ */
@@ -0,0 +1,49 @@
+#ifndef COMMANDQUEUE_H_
+#define COMMANDQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+
+/*
+ * Lock-free ring buffer between exactly one producer thread and one
+ * consumer thread. push() fails instead of blocking when the ring is full.
+ * N must be a power of two.
+ */
+template<class T, size_t N>
+class CommandQueue
+{
+public:
+    CommandQueue() : _head(0), _tail(0) {
+        static_assert((N & (N - 1)) == 0, "CommandQueue size must be a power of two");
+    }
+
+    // producer side
+    bool push(const T& item) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        _items[tail & (N - 1)] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool pop(T& item) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = _items[head & (N - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T _items[N];
+    // keep the two indices on their own cache lines
+    alignas(64) std::atomic<size_t> _head;
+    alignas(64) std::atomic<size_t> _tail;
+};
+
+#endif /* COMMANDQUEUE_H_ */
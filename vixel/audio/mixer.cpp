@@ -0,0 +1,398 @@
+#include <iostream>
+#include "mixer.h"
+#include "wav.h"
+#include "adpcm.h"
+
+// a voice handle is the voice index plus a generation, so stale handles can be ignored
+#define VOICE_BITS 8
+#define VOICE_MASK ((1 << VOICE_BITS) - 1)
+
+// bytes per channel in an ADPCM block we encode ourselves (505 samples)
+#define ADPCM_BLOCK 256
+
+Mixer::Mixer(int voices, size_t pcmBudget)
+{
+    _pcmBudget = pcmBudget;
+    _pcmResident = 0;
+    _listenerX = 0;
+    _listenerY = 0;
+    _epoch = std::chrono::steady_clock::now();
+
+    if (voices > VOICE_MASK + 1) {
+        voices = VOICE_MASK + 1;
+    }
+    for (int i = 0; i < voices; i++) {
+        Voice v;
+        v.source = 0;
+        alGenSources((ALuint) 1, &v.source);
+        alSourcef(v.source, AL_PITCH, 1.0f);
+        alSourcei(v.source, AL_LOOPING, AL_FALSE);
+        v.sample = -1;
+        v.generation = 0;
+        v.started = 0;
+        v.x = 0;
+        v.y = 0;
+        _voices.push_back(v);
+    }
+}
+
+Mixer::~Mixer()
+{
+    for (Voice& v : _voices) {
+        alSourceStop(v.source);
+        alSourcei(v.source, AL_BUFFER, 0);
+        alDeleteSources(1, &v.source);
+    }
+    for (Sample& s : _samples) {
+        if (s.buffer) {
+            alDeleteBuffers(1, &s.buffer);
+        }
+    }
+}
+
+int Mixer::load(std::string filename)
+{
+    for (size_t i = 0; i < _samples.size(); i++) {
+        if (_samples[i].filename == filename) {
+            return (int)i;
+        }
+    }
+
+    std::cout << "Loading WAV: " << filename << std::endl;
+    Sample s;
+    s.filename = filename;
+    s.buffer = 0;
+    s.format = 0;
+    s.frequency = 0;
+    s.channels = 0;
+    s.blockAlign = 0;
+    s.pcmSize = 0;
+    s.lastUsed = -1000.0;
+    s.gain = 1.0f;
+    s.priority = 0;
+    s.minInterval = 0.05;
+    s.maxVoices = 4;
+    s.lastPlayed = -1000.0;
+
+    WavStream stream;
+    if (!stream.open(filename)) {
+        std::cerr << "Unable to load: " << filename << std::endl;
+        _samples.push_back(s);
+        return (int)_samples.size() - 1;
+    }
+    s.format = stream.format();
+    s.frequency = stream.frequency();
+    s.channels = stream.channels();
+
+    if (stream.compressed()) {
+        // keep the file's ADPCM blocks as they are
+        s.adpcm.resize(stream.rawSize());
+        s.adpcm.resize(stream.readRaw(s.adpcm.data(), s.adpcm.size()));
+        s.blockAlign = stream.rawBlockAlign();
+        s.pcmSize = stream.dataSize();
+    } else {
+        std::vector<unsigned char> pcm(stream.dataSize());
+        pcm.resize(stream.read(pcm.data(), pcm.size()));
+        s.pcmSize = pcm.size();
+
+        bool wide = s.format == AL_FORMAT_MONO16 || s.format == AL_FORMAT_STEREO16;
+        if (wide && !pcm.empty()) {
+            s.blockAlign = ADPCM_BLOCK * s.channels;
+            s.adpcm = imaEncode((const short*)&pcm[0], pcm.size() / (2 * s.channels), s.channels, s.blockAlign);
+        } else if (!pcm.empty()) {
+            // 8-bit: ADPCM wouldn't save enough to be worth the noise, keep it resident
+            alGenBuffers(1, &s.buffer);
+            alBufferData(s.buffer, s.format, (void*) &pcm[0], ALsizei(pcm.size()), s.frequency);
+            _pcmResident += s.pcmSize;
+        }
+    }
+    if (s.buffer == 0 && s.adpcm.empty()) {
+        std::cerr << "Unable to load: " << filename << std::endl;
+    }
+    _samples.push_back(s);
+    return (int)_samples.size() - 1;
+}
+
+void Mixer::gain(int sample, float g)
+{
+    if (sample < 0 || sample >= (int)_samples.size()) {
+        return;
+    }
+    _samples[sample].gain = g;
+}
+
+void Mixer::priority(int sample, int p)
+{
+    if (sample < 0 || sample >= (int)_samples.size()) {
+        return;
+    }
+    _samples[sample].priority = p;
+}
+
+void Mixer::minInterval(int sample, float seconds)
+{
+    if (sample < 0 || sample >= (int)_samples.size()) {
+        return;
+    }
+    _samples[sample].minInterval = seconds;
+}
+
+void Mixer::maxVoices(int sample, int count)
+{
+    if (sample < 0 || sample >= (int)_samples.size()) {
+        return;
+    }
+    _samples[sample].maxVoices = count;
+}
+
+int Mixer::play(int sample, float x, float y)
+{
+    if (sample < 0 || sample >= (int)_samples.size()) {
+        return -1;
+    }
+    Sample& s = _samples[sample];
+
+    double t = now();
+    if (t - s.lastPlayed < s.minInterval) {
+        return -1; // rate limited
+    }
+    if (!decode(sample)) {
+        return -1;
+    }
+    s.lastUsed = t;
+
+    int index = pickVoice(sample, x, y);
+    if (index == -1) {
+        return -1;
+    }
+
+    Voice& v = _voices[index];
+    alSourceStop(v.source);
+    alSourcei(v.source, AL_BUFFER, s.buffer);
+    alSourcef(v.source, AL_GAIN, ALfloat(s.gain));
+    alSourcePlay(v.source);
+
+    v.sample = sample;
+    v.generation = (v.generation + 1) & 0xFFFF;
+    v.started = t;
+    v.x = x;
+    v.y = y;
+    s.lastPlayed = t;
+
+    return (v.generation << VOICE_BITS) | index;
+}
+
+bool Mixer::decode(int sample)
+{
+    Sample& s = _samples[sample];
+    if (s.buffer) {
+        return true;
+    }
+    if (s.adpcm.empty()) {
+        return false;
+    }
+    this->evict(s.pcmSize);
+
+    int samplesPerBlock = imaSamplesPerBlock(s.blockAlign, s.channels);
+    size_t blocks = (s.adpcm.size() + s.blockAlign - 1) / s.blockAlign;
+    if (_scratch.size() < blocks * samplesPerBlock * s.channels) {
+        _scratch.resize(blocks * samplesPerBlock * s.channels);
+    }
+
+    size_t frames = 0;
+    for (size_t offset = 0; offset < s.adpcm.size(); offset += s.blockAlign) {
+        size_t bytes = s.adpcm.size() - offset;
+        if (bytes > size_t(s.blockAlign)) {
+            bytes = s.blockAlign;
+        }
+        frames += imaDecodeBlock(&s.adpcm[offset], int(bytes), s.channels, &_scratch[frames * s.channels]);
+    }
+    // our own encoder pads the last block with silence
+    size_t size = frames * 2 * s.channels;
+    if (size > s.pcmSize) {
+        size = s.pcmSize;
+    }
+
+    alGenBuffers(1, &s.buffer);
+    alBufferData(s.buffer, s.format, (void*) &_scratch[0], ALsizei(size), s.frequency);
+    _pcmResident += s.pcmSize;
+    return true;
+}
+
+void Mixer::evict(size_t bytes)
+{
+    while (_pcmResident + bytes > _pcmBudget) {
+        // least recently played decoded sample that can be decoded again
+        int victim = -1;
+        for (size_t i = 0; i < _samples.size(); i++) {
+            Sample& s = _samples[i];
+            if (s.buffer == 0 || s.adpcm.empty()) {
+                continue;
+            }
+            bool sounding = false;
+            for (Voice& v : _voices) {
+                if (v.sample == (int)i && playing(v)) {
+                    sounding = true;
+                    break;
+                }
+            }
+            if (!sounding && (victim == -1 || s.lastUsed < _samples[victim].lastUsed)) {
+                victim = (int)i;
+            }
+        }
+        if (victim == -1) {
+            return; // everything decoded is playing, go over budget for now
+        }
+
+        Sample& s = _samples[victim];
+        // a stopped source still holds on to its buffer
+        for (Voice& v : _voices) {
+            if (v.sample == victim) {
+                alSourceStop(v.source);
+                alSourcei(v.source, AL_BUFFER, 0);
+            }
+        }
+        alDeleteBuffers(1, &s.buffer);
+        s.buffer = 0;
+        _pcmResident -= s.pcmSize;
+    }
+}
+
+int Mixer::pickVoice(int sample, float x, float y)
+{
+    const Sample& s = _samples[sample];
+
+    int free = -1;
+    int sameCount = 0;
+    int oldestSame = -1;
+    for (size_t i = 0; i < _voices.size(); i++) {
+        Voice& v = _voices[i];
+        if (!playing(v)) {
+            if (free == -1) {
+                free = (int)i;
+            }
+        } else if (v.sample == sample) {
+            sameCount++;
+            if (oldestSame == -1 || v.started < _voices[oldestSame].started) {
+                oldestSame = (int)i;
+            }
+        }
+    }
+
+    // too many of this sample already: restart its oldest voice
+    if (sameCount >= s.maxVoices) {
+        return oldestSame;
+    }
+    if (free != -1) {
+        return free;
+    }
+
+    // steal: lowest priority, then farthest away, then oldest
+    int victim = -1;
+    float victimDist = 0;
+    for (size_t i = 0; i < _voices.size(); i++) {
+        Voice& v = _voices[i];
+        float dx = v.x - _listenerX;
+        float dy = v.y - _listenerY;
+        float dist = dx * dx + dy * dy;
+        if (victim == -1) {
+            victim = (int)i;
+            victimDist = dist;
+            continue;
+        }
+        Voice& w = _voices[victim];
+        int vp = _samples[v.sample].priority;
+        int wp = _samples[w.sample].priority;
+        if (vp < wp
+                || (vp == wp && dist > victimDist)
+                || (vp == wp && dist == victimDist && v.started < w.started)) {
+            victim = (int)i;
+            victimDist = dist;
+        }
+    }
+
+    // never cut off something more important than what we want to play
+    if (victim == -1 || _samples[_voices[victim].sample].priority > s.priority) {
+        return -1;
+    }
+    float dx = x - _listenerX;
+    float dy = y - _listenerY;
+    if (_samples[_voices[victim].sample].priority == s.priority && dx * dx + dy * dy > victimDist) {
+        return -1;
+    }
+    return victim;
+}
+
+void Mixer::stopVoice(int handle)
+{
+    if (handle < 0) {
+        return;
+    }
+    int index = handle & VOICE_MASK;
+    if (index < (int)_voices.size() && _voices[index].generation == (handle >> VOICE_BITS)) {
+        alSourceStop(_voices[index].source);
+    }
+}
+
+void Mixer::stop(int sample)
+{
+    for (Voice& v : _voices) {
+        if (v.sample == sample) {
+            alSourceStop(v.source);
+        }
+    }
+}
+
+void Mixer::stopAll()
+{
+    for (Voice& v : _voices) {
+        alSourceStop(v.source);
+    }
+}
+
+int Mixer::playingVoices()
+{
+    int count = 0;
+    for (Voice& v : _voices) {
+        if (playing(v)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void Mixer::memoryReport()
+{
+    size_t stored = 0;
+    size_t pcm = 0;
+    std::cout << "Sample memory:" << std::endl;
+    for (Sample& s : _samples) {
+        size_t size = s.adpcm.empty() ? s.pcmSize : s.adpcm.size();
+        std::cout << "  " << s.filename << ": " << size / 1024 << " KB"
+            << (s.adpcm.empty() ? " pcm" : " adpcm")
+            << " (" << s.pcmSize / 1024 << " KB as pcm)"
+            << (s.buffer ? ", decoded" : "") << std::endl;
+        stored += size;
+        pcm += s.pcmSize;
+    }
+    std::cout << "  total: " << stored / 1024 << " KB stored, " << pcm / 1024 << " KB as pcm";
+    if (pcm > 0) {
+        std::cout << " (" << 100 - stored * 100 / pcm << "% saved)";
+    }
+    std::cout << ", " << _pcmResident / 1024 << " of " << _pcmBudget / 1024 << " KB decoded" << std::endl;
+}
+
+bool Mixer::playing(Voice& v)
+{
+    if (v.sample == -1) {
+        return false;
+    }
+    ALint source_state;
+    alGetSourcei(v.source, AL_SOURCE_STATE, &source_state);
+    return source_state == AL_PLAYING;
+}
+
+double Mixer::now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - _epoch).count();
+}
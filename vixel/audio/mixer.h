@@ -0,0 +1,100 @@
+#ifndef MIXER_H_
+#define MIXER_H_
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <AL/al.h>
+
+/*
+ * Plays one-shot samples on a fixed pool of AL sources (voices).
+ * Each sample is loaded once into a buffer that all its voices share.
+ * When every voice is busy, a new play() steals the least important one:
+ * lowest priority first, then the farthest from the listener, then the oldest.
+ * Triggers of the same sample closer together than its minimum interval are
+ * dropped, so a burst of gameplay events costs a bounded number of voices.
+ *
+ * 16-bit samples are kept in memory as IMA-ADPCM (a quarter of the size) and
+ * only decoded into an AL buffer on first play. Decoded buffers share a PCM
+ * budget; when it's full, the least recently played sample that isn't
+ * sounding is dropped back to its compressed form.
+ */
+class Mixer
+{
+public:
+    Mixer(int voices = 16, size_t pcmBudget = 8 * 1024 * 1024);
+    virtual ~Mixer();
+
+    // Load a sample, or return the handle of the one already loaded from this file
+    int load(std::string filename);
+
+    // Sample settings
+    void gain(int sample, float g);
+    void priority(int sample, int p);
+    void minInterval(int sample, float seconds);
+    void maxVoices(int sample, int count);
+
+    // Trigger a sample at (x, y). Returns a voice handle, or -1 if it was dropped.
+    int play(int sample, float x = 0, float y = 0);
+    // Stop one voice returned by play(). Does nothing if the voice was stolen since.
+    void stopVoice(int handle);
+    // Stop every voice playing this sample
+    void stop(int sample);
+    void stopAll();
+
+    void listener(float x, float y) { _listenerX = x; _listenerY = y; }
+    int voices() { return (int)_voices.size(); }
+    int playingVoices();
+
+    // Print what every sample costs, compressed and decoded
+    void memoryReport();
+
+private:
+    struct Sample
+    {
+        std::string filename;
+        ALuint buffer;              // 0 while only the compressed data is in memory
+        std::vector<unsigned char> adpcm; // empty for samples kept as PCM
+        ALenum format;
+        ALsizei frequency;
+        int channels;
+        int blockAlign;
+        size_t pcmSize;
+        double lastUsed;
+        float gain;
+        int priority;
+        double minInterval;
+        int maxVoices;
+        double lastPlayed;
+    };
+
+    struct Voice
+    {
+        ALuint source;
+        int sample;
+        int generation;
+        double started;
+        float x;
+        float y;
+    };
+
+    bool playing(Voice& v);
+    // make sure the sample has an AL buffer, decoding it if needed
+    bool decode(int sample);
+    // free decoded buffers until 'bytes' more fit in the budget
+    void evict(size_t bytes);
+    // returns the voice to use for this sample, or -1 to drop the request
+    int pickVoice(int sample, float x, float y);
+    double now();
+
+    std::vector<Sample> _samples;
+    std::vector<Voice> _voices;
+    std::vector<short> _scratch; // decode buffer, reused for every sample
+    size_t _pcmBudget;
+    size_t _pcmResident;
+    float _listenerX;
+    float _listenerY;
+    std::chrono::steady_clock::time_point _epoch;
+};
+
+#endif /* MIXER_H_ */
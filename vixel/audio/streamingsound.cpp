@@ -0,0 +1,198 @@
+#include <AL/al.h>
+#include <string>
+#include <iostream>
+#include "streamingsound.h"
+
+StreamingSound::StreamingSound()
+{
+    this->init();
+}
+
+StreamingSound::StreamingSound(std::string filename)
+{
+    this->init();
+    this->load(filename);
+}
+
+StreamingSound::~StreamingSound()
+{
+    if (_source) {
+        alSourceStop(_source);
+        alSourcei(_source, AL_BUFFER, 0);
+        alDeleteSources(1, &_source);
+    }
+    alDeleteBuffers(NUM_BUFFERS, _buffers);
+    delete[] _chunk;
+}
+
+void StreamingSound::init()
+{
+    _source = 0;
+    _looping = false;
+    _playing = false;
+    _chunk = new unsigned char[BUFFER_SIZE];
+
+    alGenSources((ALuint) 1, &_source);
+    alGenBuffers(NUM_BUFFERS, _buffers);
+
+    this->pitch(1.0);
+    this->gain(1.0);
+    this->position(0,0,0);
+    this->velocity(0,0,0);
+}
+
+bool StreamingSound::load(std::string filename)
+{
+    std::cout << "Streaming WAV: " << filename << std::endl;
+
+    alSourceStop(_source);
+    this->unqueueAll();
+    _playing = false;
+
+    bool isLoaded = _stream.open(filename);
+    if (!isLoaded) {
+        std::cerr << "Unable to load: " << filename << std::endl;
+    }
+    return isLoaded;
+}
+
+void StreamingSound::update()
+{
+    if (!_playing) {
+        return;
+    }
+
+    ALint processed = 0;
+    alGetSourcei(_source, AL_BUFFERS_PROCESSED, &processed);
+    while (processed > 0) {
+        ALuint buffer;
+        alSourceUnqueueBuffers(_source, 1, &buffer);
+        this->queue(&buffer, 1);
+        processed--;
+    }
+
+    ALint queued = 0;
+    ALint sourceState = AL_STOPPED;
+    alGetSourcei(_source, AL_BUFFERS_QUEUED, &queued);
+    alGetSourcei(_source, AL_SOURCE_STATE, &sourceState);
+    if (queued == 0) {
+        // played to the end of a file that doesn't loop
+        _playing = false;
+    } else if (sourceState != AL_PLAYING) {
+        // the queue ran dry before we got to it; pick up again
+        alSourcePlay(_source);
+    }
+}
+
+void StreamingSound::queue(ALuint* buffers, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (!this->fill(buffers[i])) {
+            break;
+        }
+        alSourceQueueBuffers(_source, 1, &buffers[i]);
+    }
+}
+
+bool StreamingSound::fill(ALuint buffer)
+{
+    size_t size = _stream.read(_chunk, BUFFER_SIZE);
+    // wrap around inside the same buffer, so the loop point has no gap
+    while (size < BUFFER_SIZE && _looping) {
+        _stream.rewind();
+        size_t got = _stream.read(_chunk + size, BUFFER_SIZE - size);
+        if (got == 0) {
+            break;
+        }
+        size += got;
+    }
+    if (size == 0) {
+        return false;
+    }
+    alBufferData(buffer, _stream.format(), (void*) _chunk, ALsizei(size), _stream.frequency());
+    return true;
+}
+
+void StreamingSound::unqueueAll()
+{
+    // only valid on a stopped source
+    alSourcei(_source, AL_BUFFER, 0);
+}
+
+void StreamingSound::pitch(float p)
+{
+    alSourcef(_source, AL_PITCH, ALfloat(p));
+}
+
+void StreamingSound::gain(float g)
+{
+    alSourcef(_source, AL_GAIN, ALfloat(g));
+}
+
+void StreamingSound::position(float x, float y, float z)
+{
+    alSource3f(_source, AL_POSITION, ALfloat(x), ALfloat(y), ALfloat(z));
+}
+
+void StreamingSound::velocity(float x, float y, float z)
+{
+    alSource3f(_source, AL_VELOCITY, ALfloat(x), ALfloat(y), ALfloat(z));
+}
+
+void StreamingSound::loop(bool l)
+{
+    // AL_LOOPING would loop the queue, not the file, so we loop while filling
+    _looping = l;
+}
+
+Sound::State StreamingSound::state()
+{
+    ALint source_state;
+    alGetSourcei(_source, AL_SOURCE_STATE, &source_state);
+    if (source_state == AL_PAUSED) {
+        return Sound::STATE_PAUSED;
+    }
+    // an underrun briefly stops the source, but we're still playing
+    if (_playing) {
+        return Sound::STATE_PLAYING;
+    }
+    return Sound::STATE_STOPPED;
+}
+
+void StreamingSound::play()
+{
+    if (!_stream.isOpen()) {
+        return;
+    }
+
+    ALint source_state;
+    alGetSourcei(_source, AL_SOURCE_STATE, &source_state);
+    if (source_state != AL_PAUSED) {
+        // (re)start from the beginning, like Sound::play()
+        alSourceStop(_source);
+        this->unqueueAll();
+        _stream.rewind();
+        this->queue(_buffers, NUM_BUFFERS);
+    }
+    alSourcePlay(_source);
+    _playing = true;
+}
+
+void StreamingSound::pause()
+{
+    alSourcePause(_source);
+    _playing = false;
+}
+
+void StreamingSound::stop()
+{
+    _playing = false;
+    alSourceStop(_source);
+    this->unqueueAll();
+    _stream.rewind();
+}
+
+void StreamingSound::rewind()
+{
+    this->stop();
+}
@@ -0,0 +1,59 @@
+#ifndef STREAMINGSOUND_H_
+#define STREAMINGSOUND_H_
+
+#include <string>
+#include <AL/al.h>
+
+#include "sound.h"
+#include "wav.h"
+
+/*
+ * A Sound for long files (music). Instead of one buffer holding the whole
+ * file, a small ring of AL buffers is queued on the source and refilled
+ * by update() as the source finishes with them.
+ * Looping is done by rewinding the file while filling, so there is no gap.
+ * Owned by the audio thread, like everything else that calls OpenAL.
+ */
+class StreamingSound
+{
+public:
+    StreamingSound();
+    StreamingSound(std::string filename);
+    virtual ~StreamingSound();
+
+    // 4 x 64KB queued: ~370ms of 44.1kHz stereo audio per buffer
+    static const int NUM_BUFFERS = 4;
+    static const int BUFFER_SIZE = 65536;
+
+    bool load(std::string filename);
+    // refill the buffers the source is done with. Call every few milliseconds.
+    void update();
+    void play();
+    void pause();
+    void stop();
+    void rewind();
+    Sound::State state();
+
+    void pitch(float p);
+    void gain(float g);
+    void loop(bool l);
+    void position(float x, float y, float z);
+    void velocity(float x, float y, float z);
+
+protected:
+    void init();
+    // queue as many free buffers as we have data for
+    void queue(ALuint* buffers, int count);
+    // fill one buffer from the file. Returns false when there's nothing left.
+    bool fill(ALuint buffer);
+    void unqueueAll();
+
+    WavStream _stream;
+    ALuint _buffers[NUM_BUFFERS];
+    ALuint _source;
+    unsigned char* _chunk;
+    bool _looping;
+    bool _playing;
+};
+
+#endif /* STREAMINGSOUND_H_ */
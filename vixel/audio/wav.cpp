@@ -3,7 +3,11 @@
 // Copyright (c) 2011 Oliver Plunkett
 
 #include <iostream>
+#include <cstring>
 #include "wav.h"
+#include "adpcm.h"
+
+#define WAVE_FORMAT_IMA_ADPCM 0x11
 
 /*
  * Struct that holds the RIFF data of the Wave file.
@@ -33,40 +37,58 @@ struct WAVE_Format
 };
 
 /*
- * Struct to hold the data of the wave file
+ * Header of every chunk that follows the RIFF header
  */
-struct WAVE_Data
+struct Chunk_Header
 {
-        char subChunkID[4]; //should contain the word data
-        int subChunk2Size; //Stores the size of the data block
+        char chunkID[4];
+        int chunkSize;
 };
 
+WavStream::WavStream()
+{
+    _file = nullptr;
+    _format = 0;
+    _frequency = 0;
+    _dataStart = 0;
+    _dataSize = 0;
+    _dataRead = 0;
+    _blockAlign = 1;
+    _channels = 0;
+    _adpcm = false;
+    _rawBlockAlign = 1;
+    _decodedSize = 0;
+    _pcmFrame = 0;
+    _pcmFrames = 0;
+}
+
+WavStream::~WavStream()
+{
+    this->close();
+}
+
 /*
- * Load wave file function. No need for ALUT with this
+ * Parse the RIFF, fmt and data headers and leave the file positioned at the
+ * first sample. Chunks we don't know (LIST, fact, ...) are skipped.
  */
-bool loadWavFile(const std::string filename, ALuint* buffer)
+bool WavStream::open(const std::string& filename)
 {
-	int ret = 0;
-    ALsizei* size = nullptr;
-    ALsizei* frequency = nullptr;
-    ALenum format = 0;
-    //Local Declarations
-    FILE* soundFile = nullptr;
-    WAVE_Format wave_format;
     RIFF_Header riff_header;
-    WAVE_Data wave_data;
-    unsigned char* data;
+    Chunk_Header chunk;
+    WAVE_Format wave_format;
+    bool hasFormat = false;
+
+    this->close();
 
     try {
-        soundFile = fopen(filename.c_str(), "rb");
-        if (!soundFile) {
+        _file = fopen(filename.c_str(), "rb");
+        if (!_file) {
             throw("File does not exist");
-		}
-//        std::cout << "File exists" << std::endl;
-
-        // Read in the first chunk into the struct
-        ret = fread(&riff_header, sizeof(RIFF_Header), 1, soundFile); if (!ret) { }
+        }
 
+        if (!fread(&riff_header, sizeof(RIFF_Header), 1, _file)) {
+            throw("Invalid RIFF or WAVE Header");
+        }
         //check for RIFF and WAVE tag in memeory
         if ((riff_header.chunkID[0] != 'R' || riff_header.chunkID[1] != 'I'
                 || riff_header.chunkID[2] != 'F'
@@ -75,87 +97,196 @@ bool loadWavFile(const std::string filename, ALuint* buffer)
                         || riff_header.format[2] != 'V'
                         || riff_header.format[3] != 'E')) {
             throw("Invalid RIFF or WAVE Header");
-        } else {
-//            std::cout << "Valid header" << std::endl;
         }
 
-        //Read in the 2nd chunk for the wave info
-        ret = fread(&wave_format, sizeof(WAVE_Format), 1, soundFile); if (!ret) { }
-        //check for fmt tag in memory
-        if (wave_format.subChunkID[0] != 'f' || wave_format.subChunkID[1] != 'm'
-                || wave_format.subChunkID[2] != 't'
-                || wave_format.subChunkID[3] != ' ') {
-            throw("Invalid Wave Format");
+        while (fread(&chunk, sizeof(Chunk_Header), 1, _file)) {
+            long next = ftell(_file) + chunk.chunkSize + (chunk.chunkSize & 1);
 
-        } else {
-//            std::cout << "Valid format" << std::endl;
+            if (chunk.chunkID[0] == 'f' && chunk.chunkID[1] == 'm'
+                    && chunk.chunkID[2] == 't' && chunk.chunkID[3] == ' ') {
+                // WAVE_Format includes the chunk header we already read
+                size_t fields = sizeof(WAVE_Format) - sizeof(Chunk_Header);
+                if (!fread(&wave_format.audioFormat, fields, 1, _file)) {
+                    throw("Invalid Wave Format");
+                }
+                hasFormat = true;
+            } else if (chunk.chunkID[0] == 'd' && chunk.chunkID[1] == 'a'
+                    && chunk.chunkID[2] == 't' && chunk.chunkID[3] == 'a') {
+                if (!hasFormat) {
+                    throw("Invalid Wave Format");
+                }
+                _dataStart = ftell(_file);
+                _dataSize = chunk.chunkSize;
+                _dataRead = 0;
+                break;
+            }
+            fseek(_file, next, SEEK_SET);
         }
-        //check for extra parameters;
-        if (wave_format.subChunkSize > 16)
-            fseek(soundFile, sizeof(short), SEEK_CUR);
-
-        //Read in the the last byte of data before the sound file
-        ret = fread(&wave_data, sizeof(WAVE_Data), 1, soundFile); if (!ret) { }
-        //check for data tag in memory
-        if (wave_data.subChunkID[0] != 'd' || wave_data.subChunkID[1] != 'a'
-                || wave_data.subChunkID[2] != 't'
-                || wave_data.subChunkID[3] != 'a') {
+        if (_dataStart == 0) {
             throw("Invalid data header");
-        } else {
-//            std::cout << "Valid data header" << std::endl;
-        }
-        //Allocate memory for data
-        data = new unsigned char[wave_data.subChunk2Size];
-
-        // Read in the sound data into the soundData variable
-        if (!fread(data, wave_data.subChunk2Size, 1, soundFile)) {
-            throw("error loading WAVE data into struct!");
-        } else {
-//            std::cout << "Loaded into struct" << std::endl;
         }
 
-        //Now we set the variables that we passed in with the
-        //data from the structs
-        size = &wave_data.subChunk2Size;
-//        std::cout << "Size" << std::endl;
-        frequency = &wave_format.sampleRate;
+        _frequency = wave_format.sampleRate;
+        _channels = wave_format.numChannels;
+        _blockAlign = wave_format.blockAlign > 0 ? wave_format.blockAlign : 1;
+        _rawBlockAlign = _blockAlign;
+        _decodedSize = _dataSize;
 
-//        std::cout << "Size and freq set" << std::endl;
         //The format is worked out by looking at the number of
         //channels and the bits per sample.
-        if (wave_format.numChannels == 1) {
-//            std::cout << "Single channel" << std::endl;
+        _format = 0;
+        _adpcm = false;
+        if (wave_format.audioFormat == WAVE_FORMAT_IMA_ADPCM) {
+            if (wave_format.bitsPerSample != 4 || _channels < 1 || _channels > 2
+                    || _rawBlockAlign <= 4 * _channels) {
+                throw("Unsupported Wave Format");
+            }
+            // read() hands out 16-bit frames
+            _adpcm = true;
+            _format = _channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+            _blockAlign = 2 * _channels;
+
+            size_t blocks = _dataSize / _rawBlockAlign;
+            size_t rest = _dataSize % _rawBlockAlign;
+            size_t frames = blocks * imaSamplesPerBlock(_rawBlockAlign, _channels);
+            if (rest >= size_t(4 * _channels)) {
+                frames += 1 + (rest - 4 * _channels) / (4 * _channels) * 8;
+            }
+            _decodedSize = frames * _blockAlign;
+            _packed.resize(_rawBlockAlign);
+            _pcm.resize(imaSamplesPerBlock(_rawBlockAlign, _channels) * _channels);
+        } else if (wave_format.numChannels == 1) {
             if (wave_format.bitsPerSample == 8)
-                format = AL_FORMAT_MONO8;
+                _format = AL_FORMAT_MONO8;
             else if (wave_format.bitsPerSample == 16)
-                format = AL_FORMAT_MONO16;
+                _format = AL_FORMAT_MONO16;
         } else if (wave_format.numChannels == 2) {
             if (wave_format.bitsPerSample == 8)
-                format = AL_FORMAT_STEREO8;
+                _format = AL_FORMAT_STEREO8;
             else if (wave_format.bitsPerSample == 16)
-                format = AL_FORMAT_STEREO16;
+                _format = AL_FORMAT_STEREO16;
+        }
+        if (_format == 0) {
+            throw("Unsupported Wave Format");
         }
-
-//        std::cout << "Format set" << std::endl;
-        //create our openAL buffer and check for success
-        alGenBuffers(1, buffer);
-//        std::cout << "Created buffer" << std::endl;
-
-        //now we put our data into the openAL buffer and
-        //check for success
-        alBufferData(*buffer, format, (void*) data, *size, *frequency);
-        //errorCheck();
-        //clean up and return true if successful
-        fclose(soundFile);
-//        std::cout << "Closing file" << std::endl;
         return true;
     } catch (const char* error) {
-        //our catch statement for if we throw a string
         std::cerr << error << " : trying to load " << filename << std::endl;
-        //clean up memory if wave loading fails
-        if (soundFile != nullptr)
-            fclose(soundFile);
-        //return false to indicate the failure to load wave
+        this->close();
         return false;
     }
 }
+
+void WavStream::close()
+{
+    if (_file != nullptr) {
+        fclose(_file);
+    }
+    _file = nullptr;
+    _dataStart = 0;
+    _dataSize = 0;
+    _dataRead = 0;
+    _decodedSize = 0;
+    _pcmFrame = 0;
+    _pcmFrames = 0;
+}
+
+size_t WavStream::read(unsigned char* dst, size_t bytes)
+{
+    if (_file == nullptr) {
+        return 0;
+    }
+    if (_adpcm) {
+        // hand out the decoded block, decode the next one when it runs out
+        size_t frameBytes = _blockAlign;
+        size_t done = 0;
+        while (bytes - done >= frameBytes) {
+            if (_pcmFrame == _pcmFrames && !this->decodeBlock()) {
+                break;
+            }
+            size_t frames = (bytes - done) / frameBytes;
+            if (frames > _pcmFrames - _pcmFrame) {
+                frames = _pcmFrames - _pcmFrame;
+            }
+            memcpy(dst + done, &_pcm[_pcmFrame * _channels], frames * frameBytes);
+            _pcmFrame += frames;
+            done += frames * frameBytes;
+        }
+        return done;
+    }
+
+    size_t left = _dataSize - _dataRead;
+    if (bytes > left) {
+        bytes = left;
+    }
+    // never hand out half a sample frame
+    bytes -= bytes % _blockAlign;
+
+    size_t got = fread(dst, 1, bytes, _file);
+    _dataRead += got;
+    return got;
+}
+
+size_t WavStream::readRaw(unsigned char* dst, size_t bytes)
+{
+    if (_file == nullptr) {
+        return 0;
+    }
+    size_t left = _dataSize - _dataRead;
+    if (bytes > left) {
+        bytes = left;
+    }
+    size_t got = fread(dst, 1, bytes, _file);
+    _dataRead += got;
+    return got;
+}
+
+bool WavStream::decodeBlock()
+{
+    size_t got = this->readRaw(&_packed[0], _rawBlockAlign);
+    _pcmFrame = 0;
+    _pcmFrames = imaDecodeBlock(&_packed[0], int(got), _channels, &_pcm[0]);
+    return _pcmFrames > 0;
+}
+
+void WavStream::rewind()
+{
+    if (_file != nullptr) {
+        fseek(_file, _dataStart, SEEK_SET);
+        _dataRead = 0;
+        _pcmFrame = 0;
+        _pcmFrames = 0;
+    }
+}
+
+/*
+ * Load wave file function. No need for ALUT with this
+ */
+bool loadWavFile(const std::string filename, ALuint* buffer)
+{
+    WavStream stream;
+    if (!stream.open(filename)) {
+        return false;
+    }
+
+    //Allocate memory for data
+    size_t size = stream.dataSize();
+    unsigned char* data = new unsigned char[size];
+
+    // Read in the sound data into the soundData variable
+    if (stream.read(data, size) != size - (size % stream.blockAlign())) {
+        std::cerr << "error loading WAVE data into struct!" << " : trying to load " << filename << std::endl;
+        delete[] data;
+        return false;
+    }
+
+    //create our openAL buffer and check for success
+    alGenBuffers(1, buffer);
+
+    //now we put our data into the openAL buffer and
+    //check for success
+    alBufferData(*buffer, stream.format(), (void*) data, ALsizei(size - (size % stream.blockAlign())), stream.frequency());
+    //OpenAL keeps its own copy
+    delete[] data;
+    return true;
+}
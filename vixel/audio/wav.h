@@ -3,9 +3,67 @@
 
 #include <stdio.h>
 #include <string>
+#include <vector>
 #include <AL/al.h>
 #include <AL/alc.h>
 
+/*
+ * Reads the sample data of a WAVE file in pieces.
+ * open() only parses the headers, so a long file (music) never has to be
+ * resident in memory as a whole.
+ * IMA-ADPCM files are decoded one block at a time while reading, so to the
+ * caller they look like 16-bit PCM.
+ */
+class WavStream
+{
+public:
+    WavStream();
+    virtual ~WavStream();
+
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() { return _file != nullptr; }
+
+    // Read up to 'bytes' bytes of (decoded) sample data. Returns 0 at the end of the data.
+    size_t read(unsigned char* dst, size_t bytes);
+    // Read the data chunk as stored in the file, without decoding
+    size_t readRaw(unsigned char* dst, size_t bytes);
+    // Seek back to the first sample
+    void rewind();
+
+    ALenum format() { return _format; }
+    ALsizei frequency() { return _frequency; }
+    int channels() { return _channels; }
+    // size and frame size of the data read() returns
+    size_t dataSize() { return _decodedSize; }
+    int blockAlign() { return _blockAlign; }
+
+    // the data as stored in the file
+    bool compressed() { return _adpcm; }
+    size_t rawSize() { return _dataSize; }
+    int rawBlockAlign() { return _rawBlockAlign; }
+
+private:
+    bool decodeBlock();
+
+    FILE* _file;
+    ALenum _format;
+    ALsizei _frequency;
+    long _dataStart;
+    size_t _dataSize;
+    size_t _dataRead;
+    int _blockAlign;
+    int _channels;
+
+    bool _adpcm;
+    int _rawBlockAlign;
+    size_t _decodedSize;
+    std::vector<unsigned char> _packed;
+    std::vector<short> _pcm;
+    size_t _pcmFrame;
+    size_t _pcmFrames;
+};
+
 bool loadWavFile(const std::string filename, ALuint* buffer);
 
 #endif
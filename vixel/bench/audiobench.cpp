@@ -0,0 +1,198 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+// Headless audio benchmark and golden output.
+// Mixes on the loopback backend, so it needs no sound hardware.
+//
+//   vixel_audiobench                  mixing throughput for 1..256 voices
+//   vixel_audiobench --golden out.raw also write the reference mix (s16 stereo)
+//   vixel_audiobench --check ref.raw  also compare the mix with a reference written by --golden
+//
+// Exits with 1 when the loopback device doesn't open or the mix isn't the reference.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <stdint.h>
+
+#include "../audio/audiobackend.h"
+#include "../audio/mixer.h"
+#include "../audio/wav.h"
+
+static const char* samples[] = {
+	"assets/audio/land_die.wav",
+	"assets/audio/fall.wav",
+	"assets/audio/drowning.wav",
+	"assets/audio/drown.wav",
+	"assets/audio/enter_home.wav",
+	"assets/audio/explode.wav",
+	"assets/audio/blip.wav"
+};
+static const int numSamples = sizeof(samples) / sizeof(samples[0]);
+
+static uint64_t fnv1a(const unsigned char* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// How many voice-milliseconds of audio get mixed per millisecond of wall time
+static void benchmarkVoices(LoopbackBackend& backend, const std::vector<ALuint>& buffers, int voices)
+{
+	const int block = 1024;
+	const int seconds = 2;
+
+	std::vector<ALuint> sources(voices);
+	alGenSources(voices, &sources[0]);
+	for (int i = 0; i < voices; i++) {
+		alSourcei(sources[i], AL_BUFFER, buffers[i % buffers.size()]);
+		alSourcei(sources[i], AL_LOOPING, AL_TRUE);
+		// off-by-a-bit pitches so every voice has to be resampled
+		alSourcef(sources[i], AL_PITCH, 0.9f + 0.2f * float(i % 7) / 6.0f);
+		alSourcef(sources[i], AL_GAIN, 1.0f / voices);
+	}
+	alSourcePlayv(voices, &sources[0]);
+
+	int frames = backend.frequency() * seconds;
+	auto start = std::chrono::steady_clock::now();
+	for (int done = 0; done < frames; done += block) {
+		backend.render(block);
+	}
+	double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	alSourceStopv(voices, &sources[0]);
+	alDeleteSources(voices, &sources[0]);
+
+	double audioMs = seconds * 1000.0;
+	std::cout << "{\"voices\": " << voices
+		<< ", \"wall_ms\": " << wallMs
+		<< ", \"realtime_factor\": " << audioMs / wallMs
+		<< ", \"voice_ms_per_ms\": " << voices * audioMs / wallMs
+		<< "}" << std::endl;
+}
+
+// Play every effect once through the Mixer, false when there's no loopback device
+static bool goldenMix(std::vector<unsigned char>& mix)
+{
+	LoopbackBackend backend(44100, ALC_SHORT_SOFT);
+	if (!backend.open()) {
+		return false;
+	}
+
+	{
+		Mixer mixer(16);
+		std::vector<int> handles;
+		for (int i = 0; i < numSamples; i++) {
+			handles.push_back(mixer.load(samples[i]));
+		}
+
+		mix.clear();
+		const int block = 4410; // 100ms
+		for (int t = 0; t < 30; t++) {
+			// a new effect every 200ms
+			if (t % 2 == 0 && t / 2 < numSamples) {
+				mixer.play(handles[t / 2], float(t), 0.0f);
+			}
+			backend.render(block);
+			mix.insert(mix.end(), backend.output().begin(), backend.output().end());
+		}
+	}
+	backend.close();
+	return true;
+}
+
+// Compare a mix with a reference file, the first byte that differs or -1
+static long compareMix(const std::vector<unsigned char>& mix, const std::string& referenceFile)
+{
+	std::ifstream in(referenceFile.c_str(), std::ios::binary);
+	std::vector<unsigned char> reference((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	size_t size = std::min(mix.size(), reference.size());
+	for (size_t i = 0; i < size; i++) {
+		if (mix[i] != reference[i]) {
+			return long(i);
+		}
+	}
+	return (mix.size() == reference.size()) ? -1 : long(size);
+}
+
+int main(int argc, char* argv[])
+{
+	std::string golden;
+	std::string check;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+			golden = argv[++i];
+		}
+		else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+			check = argv[++i];
+		}
+	}
+
+	{
+		LoopbackBackend backend(44100, ALC_FLOAT_SOFT);
+		if (!backend.open()) {
+			std::cerr << "No loopback device, nothing to benchmark." << std::endl;
+			return 1;
+		}
+
+		std::vector<ALuint> buffers;
+		for (int i = 0; i < numSamples; i++) {
+			ALuint buffer = 0;
+			if (loadWavFile(samples[i], &buffer)) {
+				buffers.push_back(buffer);
+			}
+		}
+		if (buffers.empty()) {
+			std::cerr << "No samples found, run from the build directory." << std::endl;
+			return 1;
+		}
+
+		int counts[] = { 1, 8, 32, 128, 256 };
+		for (int voices : counts) {
+			benchmarkVoices(backend, buffers, voices);
+		}
+
+		alDeleteBuffers((ALsizei)buffers.size(), &buffers[0]);
+		backend.close();
+	}
+
+	std::vector<unsigned char> mix;
+	if (!goldenMix(mix) || mix.empty()) {
+		std::cerr << "No loopback device, no golden mix." << std::endl;
+		return 1;
+	}
+	uint64_t hash = fnv1a(&mix[0], mix.size());
+	if (!golden.empty()) {
+		std::ofstream out(golden.c_str(), std::ios::binary);
+		out.write((const char*)&mix[0], mix.size());
+	}
+	long mismatch = -1;
+	if (!check.empty()) {
+		if (!std::ifstream(check.c_str(), std::ios::binary)) {
+			std::cerr << "Can't read " << check << std::endl;
+			return 1;
+		}
+		mismatch = compareMix(mix, check);
+	}
+	std::cout << "{\"golden_hash\": \"" << std::hex << hash << std::dec << "\""
+		<< ", \"mismatch_at\": " << mismatch
+		<< "}" << std::endl;
+	if (mismatch >= 0) {
+		std::cerr << "The mix differs from " << check << " at byte " << mismatch << "." << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,1016 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+// Headless simulation benchmark.
+// Runs the falling sand rules without a window and counts heap allocations,
+// a tick in steady state must not allocate. Also checks that a tick gives the
+// same state on one thread as on many, that a tick spread over several calls
+// gives the same state as a whole one, that rewinding the snapshot ring
+// gives back every state it saved, that a world paged out to disk comes
+// back the same and that the homes and the region queries count right. Exits
+// with 1 if any of them fails.
+//
+//   vixel_bench               ms per tick (mean, p50, p99), ticks per second, ns per
+//                             cell, awake chunks, allocations and cache misses per
+//                             tick for every mode, scene and size, on one thread and
+//                             on all of them. Cache misses are -1 where the system
+//                             doesn't count them. Then every level of the game, with
+//                             its characters and homes, the way the game ticks it
+//   vixel_bench --threads N   compare one thread with N instead
+//   vixel_bench --kernel K    scan with the avx2, sse2 or scalar kernel
+//   vixel_bench --levels DIR  where the level*.tga files are (assets/levels)
+//   vixel_bench --replay FILE play a recording of `vixel --record FILE` back
+//                             instead: ms per tick, with and without the characters
+//                             and the input, and the hash `vixel --replay FILE` ends with
+
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <thread>
+#include <stdint.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+#include "../sim/cellgrid.h"
+#include "../sim/simulation.h"
+#include "../sim/rowkernels.h"
+#include "../sim/snapshot.h"
+#include "../sim/chunkpager.h"
+#include "../world.h"
+#include "../session.h"
+#include "../inputrecording.h"
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// A hardware counter of this thread, -1 when there's none
+static int openCounter(uint32_t type, uint64_t config)
+{
+#ifdef __linux__
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.inherit = 1; // count the worker threads too
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+static void startCounter(int fd)
+{
+#ifdef __linux__
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+// Stop a counter and read it, -1 when there's none
+static double stopCounter(int fd)
+{
+#ifdef __linux__
+	uint64_t value = 0;
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &value, sizeof(value)) == sizeof(value)) {
+			close(fd);
+			return double(value);
+		}
+		close(fd);
+	}
+#endif
+	return -1;
+}
+
+// A bit of everything: ground, falling liquids and burning wood
+static void fillScene(CellGrid& grid, unsigned int seed)
+{
+	srand(seed);
+	const int w = grid.width();
+	const int h = grid.height();
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			int mat = 0;
+			if (y < 2) {
+				mat = 13; //indestructible floor
+			}
+			else if (y < h / 5) {
+				mat = rand() % 4 == 0 ? 3 : 1; //stone and dirt
+			}
+			else if (y > h * 3 / 4) {
+				int r = rand() % 20;
+				if (r < 4) mat = 6; //water
+				else if (r < 6) mat = 1; //dirt
+				else if (r == 6) mat = 5; //lava
+				else if (r == 7) mat = 7; //acid
+			}
+			else if (x % 23 == 0) {
+				mat = 2; //wood
+			}
+			else if (x % 23 == 1 && y == h / 2) {
+				mat = 4; //fire
+			}
+			grid.material(grid.id(x, y), Material(mat));
+		}
+	}
+}
+
+// A settled level with a little activity in one corner: a tick should cost
+// next to nothing, however big the grid is
+static void fillQuietScene(CellGrid& grid, unsigned int seed)
+{
+	srand(seed);
+	const int w = grid.width();
+	const int h = grid.height();
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			int mat = 0;
+			if (y < 2) {
+				mat = 13; //indestructible floor
+			}
+			else if (y < h / 5) {
+				mat = 3; //stone
+			}
+			else if (x < 16 && y < h / 5 + 4) {
+				mat = 5; //a lava pool that keeps melting its floor
+			}
+			else if (x < 16 && y > h / 5 + 20 && y < h / 5 + 28) {
+				mat = 6; //water falling on it
+			}
+			grid.material(grid.id(x, y), Material(mat));
+		}
+	}
+}
+
+// Loose dirt raining down on a floor: bulk falling sand, mostly air around it
+static void fillSandScene(CellGrid& grid, unsigned int seed)
+{
+	srand(seed);
+	const int w = grid.width();
+	const int h = grid.height();
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			int mat = 0;
+			if (y < 2) {
+				mat = 13; //indestructible floor
+			}
+			else if (y > h / 4 && rand() % 3 == 0) {
+				mat = 1; //dirt
+			}
+			grid.material(grid.id(x, y), Material(mat));
+		}
+	}
+}
+
+// Water from wall to wall, falling into a shallow space: every cell moves or may
+static void fillWaterScene(CellGrid& grid, unsigned int seed)
+{
+	const int w = grid.width();
+	const int h = grid.height();
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			int mat = 6; //water
+			if (y < 2) {
+				mat = 13; //indestructible floor
+			}
+			else if (y < h / 8) {
+				mat = 0; //room to fall into
+			}
+			grid.material(grid.id(x, y), Material(mat));
+		}
+	}
+}
+
+// Rows of trees on dirt, set on fire at the roots: the fire spreads through all of them
+static void fillForestScene(CellGrid& grid, unsigned int seed)
+{
+	srand(seed);
+	const int w = grid.width();
+	const int h = grid.height();
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			int mat = 0;
+			if (y < 2) {
+				mat = 13; //indestructible floor
+			}
+			else if (y < h / 8) {
+				mat = 1; //dirt
+			}
+			else if (y < h * 7 / 8 && x % 6 < 4) {
+				mat = (y == h / 8 && x % 24 == 0) ? 4 : 2; //wood, fire at the roots
+			}
+			grid.material(grid.id(x, y), Material(mat));
+		}
+	}
+}
+
+// A chunk of a big world: rolling hills of dirt and stone, pools of water and
+// a little lava on top of them. Only depends on where the chunk is
+static void fillWorldChunk(int wcx, int wcy, int worldHeight, Material* cells)
+{
+	const int size = CellGrid::CHUNK_SIZE;
+	for (int ly = 0; ly < size; ly++) {
+		for (int lx = 0; lx < size; lx++) {
+			int x = wcx * size + lx;
+			int y = wcy * size + ly;
+			uint32_t r = uint32_t(x) * 0x9E3779B1u ^ uint32_t(y) * 0x85EBCA77u;
+			r ^= r >> 15;
+			r *= 0x2C1B3C6Du;
+			r ^= r >> 13;
+			int ground = worldHeight / 2 + ((x / 64) % 7) * 24 - ((x / 200) % 5) * 30;
+			int mat = 0;
+			if (y < 2) {
+				mat = 13; //indestructible floor
+			}
+			else if (y < ground - 40) {
+				mat = (r % 5 == 0) ? 1 : 3; //stone and dirt
+			}
+			else if (y < ground) {
+				mat = 1; //dirt
+			}
+			else if (y < ground + 24 && (x / 96) % 4 == 0) {
+				mat = (r % 97 == 0) ? 5 : 6; //water, a little lava
+			}
+			cells[ly * size + lx] = Material(mat);
+		}
+	}
+}
+
+enum Scene { SCENE_BUSY, SCENE_QUIET, SCENE_SAND, SCENE_WATER, SCENE_FOREST };
+static const char* sceneNames[] = { "busy", "quiet", "sand", "water", "forest" };
+
+// Tick times in ms, sorted
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) {
+		return 0;
+	}
+	size_t i = size_t(p * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static bool benchmark(Simulation::Mode mode, const char* name, Scene scene, int w, int h, int ticks, int threads)
+{
+	CellGrid grid;
+	grid.resize(w, h);
+	switch (scene) {
+		case SCENE_BUSY: fillScene(grid, 1); break;
+		case SCENE_QUIET: fillQuietScene(grid, 1); break;
+		case SCENE_SAND: fillSandScene(grid, 1); break;
+		case SCENE_WATER: fillWaterScene(grid, 1); break;
+		case SCENE_FOREST: fillForestScene(grid, 1); break;
+	}
+
+	Simulation simulation;
+	simulation.mode(mode);
+	simulation.threads(threads);
+
+	// let the first ticks settle anything that happens once
+	int frame = 0;
+	for (; frame < 10; frame++) {
+		simulation.step(grid, frame);
+	}
+
+#ifdef __linux__
+	int l1 = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	int llc = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#else
+	int l1 = -1;
+	int llc = -1;
+#endif
+
+	std::vector<double> times;
+	times.reserve(ticks);
+	uint64_t before = allocations.load();
+	double awake = 0;
+	startCounter(l1);
+	startCounter(llc);
+	auto start = std::chrono::steady_clock::now();
+	auto last = start;
+	for (int i = 0; i < ticks; i++, frame++) {
+		simulation.step(grid, frame);
+		awake += grid.awakeChunks();
+		auto now = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+		last = now;
+	}
+	double ms = std::chrono::duration<double, std::milli>(last - start).count();
+	double l1Misses = stopCounter(l1);
+	double llcMisses = stopCounter(llc);
+	uint64_t allocated = allocations.load() - before;
+	double cells = double(w) * h * ticks;
+	std::sort(times.begin(), times.end());
+
+	std::cout << "{\"mode\": \"" << name << "\""
+		<< ", \"scene\": \"" << sceneNames[scene] << "\""
+		<< ", \"kernel\": \"" << rowKernelName() << "\""
+		<< ", \"width\": " << w
+		<< ", \"height\": " << h
+		<< ", \"threads\": " << threads
+		<< ", \"ticks\": " << ticks
+		<< ", \"ms_per_tick\": " << ms / ticks
+		<< ", \"p50_ms\": " << percentile(times, 0.5)
+		<< ", \"p99_ms\": " << percentile(times, 0.99)
+		<< ", \"ticks_per_s\": " << ticks * 1000.0 / ms
+		<< ", \"ns_per_cell\": " << ms * 1e6 / cells
+		<< ", \"mcells_per_s\": " << cells / (ms * 1000.0)
+		<< ", \"awake_chunks\": " << awake / ticks
+		<< ", \"chunks\": " << grid.chunksX() * grid.chunksY()
+		<< ", \"bytes_per_cell\": " << double(grid.memoryUsage()) / grid.size()
+		<< ", \"allocs_per_tick\": " << double(allocated) / ticks
+		<< ", \"l1d_misses_per_kcell\": " << (l1Misses < 0 ? -1 : l1Misses * 1000 / cells)
+		<< ", \"llc_misses_per_kcell\": " << (llcMisses < 0 ? -1 : llcMisses * 1000 / cells)
+		<< ", \"hash\": \"" << std::hex << grid.hash() << std::dec << "\""
+		<< "}" << std::endl;
+	return allocated == 0;
+}
+
+// Tick a level of the game with its characters awake, the way the game does
+static bool levelBenchmark(const std::string& dir, int level, int ticks)
+{
+	int w;
+	int h;
+	int bytesPerPixel;
+	std::vector<uint8_t> pixels;
+	std::string name = "level" + std::to_string(level);
+	if (!readLevelImage(dir + "/" + name + ".tga", w, h, bytesPerPixel, pixels)) {
+		return false;
+	}
+
+	World world;
+	world.cells.resize(w, h);
+	world.load(&pixels[0], bytesPerPixel, Session::palette, Session::MATERIALS);
+	for (size_t c = 0; c < world.characters.size(); c++) {
+		world.characters.wake(c);
+	}
+
+	int frame = 0;
+	for (; frame < 10; frame++) {
+		world.tick(frame);
+	}
+
+	std::vector<double> times;
+	times.reserve(ticks);
+	auto start = std::chrono::steady_clock::now();
+	auto last = start;
+	for (int i = 0; i < ticks; i++, frame++) {
+		world.tick(frame);
+		auto now = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+		last = now;
+	}
+	double ms = std::chrono::duration<double, std::milli>(last - start).count();
+	double cells = double(w) * h * ticks;
+	std::sort(times.begin(), times.end());
+
+	std::cout << "{\"level\": \"" << name << "\""
+		<< ", \"width\": " << w
+		<< ", \"height\": " << h
+		<< ", \"characters\": " << world.characters.size()
+		<< ", \"homes\": " << world.homes.size()
+		<< ", \"ticks\": " << ticks
+		<< ", \"ms_per_tick\": " << ms / ticks
+		<< ", \"p50_ms\": " << percentile(times, 0.5)
+		<< ", \"p99_ms\": " << percentile(times, 0.99)
+		<< ", \"ticks_per_s\": " << ticks * 1000.0 / ms
+		<< ", \"ns_per_cell\": " << ms * 1e6 / cells
+		<< ", \"hash\": \"" << std::hex << world.cells.hash() << std::dec << "\""
+		<< "}" << std::endl;
+	return true;
+}
+
+// Play a recording of the game back without a window: the same Session the Game
+// runs, with whole ticks where the recording ticked and every click and key on
+// the level, so a recording gives the hash `vixel --replay` prints
+static bool replay(const std::string& dir, const std::string& path)
+{
+	InputRecording recording;
+	if (!recording.play(path)) {
+		std::cerr << "Can't replay " << path << std::endl;
+		return false;
+	}
+	//the screen is the size of the levels
+	int w;
+	int h;
+	int bytesPerPixel;
+	std::vector<uint8_t> pixels;
+	if (!readLevelImage(dir + "/level0.tga", w, h, bytesPerPixel, pixels)) {
+		std::cerr << "No levels in " << dir << ", use --levels DIR." << std::endl;
+		return false;
+	}
+
+	//start the way the recording did
+	Session session;
+	session.levels = dir;
+	session.world.simulation.seed(recording.seed());
+	session.level = recording.level();
+	session.frameCount = recording.frameCount();
+	session.start(w, h);
+
+	int frames = 0;
+	int ticks = 0;
+	InputFrame frame;
+	auto start = std::chrono::steady_clock::now();
+	while (recording.next(frame)) {
+		ticks += session.runFrame(frame, true);
+		frames++;
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "{\"replay\": \"" << path << "\""
+		<< ", \"frames\": " << frames
+		<< ", \"ticks\": " << ticks
+		<< ", \"level\": " << session.level
+		<< ", \"ms_per_tick\": " << (ticks > 0 ? ms / ticks : 0.0)
+		<< ", \"sim_ms_per_tick\": " << (ticks > 0 ? session.wholeTickSeconds * 1000.0 / ticks : 0.0)
+		<< ", \"hash\": \"" << std::hex << session.world.cells.hash() << std::dec << "\""
+		<< "}" << std::endl;
+	return true;
+}
+
+// Shelves full of walkers with steps, walls and pools to walk into: the characters
+// of a tick, without the simulation
+static void walkers(int w, int h, int ticks)
+{
+	World world;
+	world.cells.resize(w, h);
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			int mat = 0;
+			int shelf = y % 16;
+			if (shelf == 0) {
+				mat = 13; //a floor every 16 rows
+			}
+			else if (shelf == 1 && x % 40 < 20) {
+				mat = 3; //a step up
+			}
+			else if (shelf < 8 && x % 160 == 159) {
+				mat = 3; //a wall to turn around at
+			}
+			else if (shelf < 4 && x % 160 > 100 && x % 160 < 110) {
+				mat = 6; //a pool
+			}
+			world.cells.material(world.cells.id(x, y), Material(mat));
+		}
+	}
+	for (int y = 2; y + 5 < h; y += 16) {
+		for (int x = 1; x + 3 < w; x += 8) {
+			world.characters.wake(world.characters.add(x, y, 3, 5));
+		}
+	}
+	world.placeCharacters();
+
+	std::vector<double> times;
+	times.reserve(ticks);
+	double ms = 0;
+	double awake = 0;
+	for (int frame = 0; frame < ticks; frame++) {
+		world.updateField(frame);
+		awake += world.cells.awakeChunks();
+		auto start = std::chrono::steady_clock::now();
+		world.updateCharacters(frame);
+		double t = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		times.push_back(t);
+		ms += t;
+	}
+	std::sort(times.begin(), times.end());
+
+	std::cout << "{\"check\": \"walkers\""
+		<< ", \"width\": " << w
+		<< ", \"height\": " << h
+		<< ", \"characters\": " << world.characters.size()
+		<< ", \"ticks\": " << ticks
+		<< ", \"ms_per_tick\": " << ms / ticks
+		<< ", \"p99_ms\": " << percentile(times, 0.99)
+		<< ", \"ns_per_character\": " << ms * 1e6 / (double(ticks) * world.characters.size())
+		<< ", \"awake_chunks\": " << awake / ticks
+		<< ", \"hash\": \"" << std::hex << world.cells.hash() << std::dec << "\""
+		<< "}" << std::endl;
+}
+
+// Rows of big wooden homes, a few of them set on fire: updateHomes() keeps the wood
+// counts up from the cells that changed, check them against counting every perimeter
+// again. rescan_ms is that count plus drawing every home again, what a tick used to do
+static bool homeWatch(int w, int h, int size, int ticks)
+{
+	World world;
+	world.cells.resize(w, h);
+	const int spacing = size + 8;
+	int homeCount = 0;
+	for (int hy = 4; hy + size + 4 < h; hy += spacing) {
+		for (int hx = 4; hx + size + 4 < w; hx += spacing) {
+			//a wooden frame around the home, every 8th one burns from a corner
+			for (int y = hy - 1; y <= hy + size; y++) {
+				for (int x = hx - 1; x <= hx + size; x++) {
+					if (x == hx - 1 || x == hx + size || y == hy - 1 || y == hy + size) {
+						world.cells.material(world.cells.id(x, y), 2);
+					}
+				}
+			}
+			if (homeCount % 8 == 0) {
+				world.cells.material(world.cells.id(hx - 1, hy - 1), 4);
+			}
+			Home home(hx, hy);
+			home.spriteW = size;
+			home.spriteH = size;
+			world.homes.push_back(home);
+			homeCount++;
+		}
+	}
+	world.watchHomes();
+
+	double ms = 0;
+	double rescanMs = 0;
+	int rescans = 0;
+	int mismatch = -1;
+	for (int frame = 0; frame < ticks; frame++) {
+		world.updateField(frame);
+		auto start = std::chrono::steady_clock::now();
+		world.updateHomes();
+		ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (frame % 20 != 0 && frame != ticks - 1) {
+			continue;
+		}
+		start = std::chrono::steady_clock::now();
+		for (const Home& home : world.homes) {
+			int wood = 0;
+			for (int x = 0; x < home.spriteW; x++) {
+				int above = world.cells.id(home.position.x + x, home.position.y + home.spriteH);
+				int below = world.cells.id(home.position.x + x, home.position.y - 1);
+				wood += (above != -1 && world.cells[above] == 2) + (below == -1 || world.cells[below] == 2);
+			}
+			for (int y = 0; y < home.spriteH; y++) {
+				int left = world.cells.id(home.position.x - 1, home.position.y + y);
+				int right = world.cells.id(home.position.x + home.spriteW, home.position.y + y);
+				wood += (left != -1 && world.cells[left] == 2) + (right != -1 && world.cells[right] == 2);
+			}
+			if (wood != home.wood && mismatch < 0) {
+				mismatch = frame;
+			}
+			//and draw it again, the way updateHomes() did every tick before it counted from the changes
+			for (int y = 0; y < home.spriteH; y++) {
+				for (int x = 0; x < home.spriteW; x++) {
+					int pos = world.cells.id(home.position.x + x, home.position.y + y);
+					if (pos != -1 && world.cells[pos] != 2 && world.cells[pos] != 4) {
+						world.cells.material(pos, home.active ? 11 : 10);
+					}
+				}
+			}
+		}
+		rescanMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		rescans++;
+	}
+	int active = 0;
+	for (const Home& home : world.homes) {
+		active += home.active;
+	}
+
+	std::cout << "{\"check\": \"homes\""
+		<< ", \"width\": " << w
+		<< ", \"height\": " << h
+		<< ", \"homes\": " << world.homes.size()
+		<< ", \"home_size\": " << size
+		<< ", \"ticks\": " << ticks
+		<< ", \"ms_per_tick\": " << ms / ticks
+		<< ", \"rescan_ms\": " << rescanMs / rescans
+		<< ", \"active\": " << active
+		<< ", \"mismatch_at\": " << mismatch
+		<< "}" << std::endl;
+	return mismatch < 0;
+}
+
+// Tick the busy scene and ask about random strips and boxes of it in between: any
+// and count by chunk and row mask against a loop over every cell, right after the
+// cells changed, and how long both take
+static bool regions(int threads, int w, int h, int ticks, int queries, bool sliced)
+{
+	CellGrid grid;
+	grid.resize(w, h);
+	fillScene(grid, 1);
+	Simulation simulation;
+	simulation.threads(threads);
+
+	const uint32_t sets[] = { 1u << MAT_AIR, 1u << MAT_WOOD, 1u << MAT_WATER, (1u << MAT_FIRE) | (1u << MAT_LAVA), ~(1u << MAT_AIR) };
+	srand(2);
+	double ms = 0;
+	double scanMs = 0;
+	int asked = 0;
+	int found = 0;
+	int mismatch = -1;
+	auto ask = [&](int frame, int n) {
+		for (int q = 0; q < n; q++) {
+			//a row, a column or a box, up to a few chunks
+			CellGrid::Rect r;
+			r.x0 = rand() % w;
+			r.y0 = rand() % h;
+			int shape = q % 3;
+			r.x1 = r.x0 + (shape == 1 ? 0 : rand() % 128);
+			r.y1 = r.y0 + (shape == 0 ? 0 : rand() % 128);
+			uint32_t materials = sets[rand() % 5];
+
+			auto start = std::chrono::steady_clock::now();
+			bool any = grid.any(r, materials);
+			int count = grid.count(r, materials);
+			auto mid = std::chrono::steady_clock::now();
+			int cells = 0;
+			for (int y = r.y0; y <= r.y1 && y < h; y++) {
+				for (int x = r.x0; x <= r.x1 && x < w; x++) {
+					cells += (materials >> grid[grid.id(x, y)]) & 1;
+				}
+			}
+			auto end = std::chrono::steady_clock::now();
+			ms += std::chrono::duration<double, std::milli>(mid - start).count();
+			scanMs += std::chrono::duration<double, std::milli>(end - mid).count();
+
+			asked++;
+			found += any;
+			if ((count != cells || any != (cells > 0)) && mismatch < 0) {
+				mismatch = frame;
+			}
+		}
+	};
+	for (int frame = 0; frame < ticks; frame++) {
+		if (sliced) {
+			// also between the slices of a tick, when part of the grid is the next state already
+			while (!simulation.advance(grid, frame, 0.0002)) {
+				ask(frame, queries / 10);
+			}
+		}
+		else {
+			simulation.step(grid, frame);
+		}
+		ask(frame, queries);
+	}
+
+	std::cout << "{\"check\": \"regions\""
+		<< ", \"width\": " << w
+		<< ", \"height\": " << h
+		<< ", \"threads\": " << threads
+		<< ", \"sliced\": " << (sliced ? "true" : "false")
+		<< ", \"queries\": " << asked
+		<< ", \"found\": " << found
+		<< ", \"us_per_query\": " << ms * 1000.0 / asked
+		<< ", \"us_per_scan\": " << scanMs * 1000.0 / asked
+		<< ", \"mismatch_at\": " << mismatch
+		<< "}" << std::endl;
+	return mismatch < 0;
+}
+
+// Run the busy scene on one thread and on more, and compare the state after every tick
+static bool determinism(Simulation::Mode mode, const char* name, int threads, int w, int h, int ticks)
+{
+	CellGrid serialGrid;
+	CellGrid parallelGrid;
+	serialGrid.resize(w, h);
+	parallelGrid.resize(w, h);
+	fillScene(serialGrid, 1);
+	fillScene(parallelGrid, 1);
+
+	Simulation serial;
+	Simulation parallel;
+	serial.mode(mode);
+	parallel.mode(mode);
+	parallel.threads(threads);
+
+	int diverged = -1;
+	for (int frame = 0; frame < ticks && diverged < 0; frame++) {
+		serial.step(serialGrid, frame);
+		parallel.step(parallelGrid, frame);
+		if (serialGrid.hash() != parallelGrid.hash()) {
+			diverged = frame;
+		}
+	}
+
+	std::cout << "{\"mode\": \"" << name << "\""
+		<< ", \"check\": \"determinism\""
+		<< ", \"width\": " << w
+		<< ", \"height\": " << h
+		<< ", \"threads\": " << threads
+		<< ", \"ticks\": " << ticks
+		<< ", \"diverged_at\": " << diverged
+		<< "}" << std::endl;
+	return diverged < 0;
+}
+
+// Run a huge busy scene whole and in slices of budgetMs, compare the state after every tick
+// and report how long the slices take. Only the state is checked: on a busy machine any slice
+// can be preempted, so the times aren't
+static bool slicing(Simulation::Mode mode, const char* name, int threads, int w, int h, int ticks, double budgetMs)
+{
+	CellGrid wholeGrid;
+	CellGrid slicedGrid;
+	wholeGrid.resize(w, h);
+	slicedGrid.resize(w, h);
+	fillScene(wholeGrid, 1);
+	fillScene(slicedGrid, 1);
+
+	Simulation whole;
+	Simulation sliced;
+	whole.mode(mode);
+	sliced.mode(mode);
+	whole.threads(threads);
+	sliced.threads(threads);
+
+	std::vector<double> times;
+	int mismatch = -1;
+	for (int frame = 0; frame < ticks; frame++) {
+		whole.step(wholeGrid, frame);
+		bool done = false;
+		while (!done) {
+			auto start = std::chrono::steady_clock::now();
+			done = sliced.advance(slicedGrid, frame, budgetMs / 1000.0);
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		if (wholeGrid.hash() != slicedGrid.hash() && mismatch < 0) {
+			mismatch = frame;
+		}
+	}
+	std::sort(times.begin(), times.end());
+	size_t over = times.end() - std::upper_bound(times.begin(), times.end(), budgetMs);
+
+	std::cout << "{\"mode\": \"" << name << "\""
+		<< ", \"check\": \"slicing\""
+		<< ", \"width\": " << w
+		<< ", \"height\": " << h
+		<< ", \"threads\": " << threads
+		<< ", \"ticks\": " << ticks
+		<< ", \"budget_ms\": " << budgetMs
+		<< ", \"slices_per_tick\": " << double(times.size()) / ticks
+		<< ", \"p50_ms\": " << percentile(times, 0.5)
+		<< ", \"p99_ms\": " << percentile(times, 0.99)
+		<< ", \"max_ms\": " << times.back()
+		<< ", \"over_budget\": " << over
+		<< ", \"mismatch_at\": " << mismatch
+		<< "}" << std::endl;
+	return mismatch < 0;
+}
+
+// Build a world much bigger than the grid in a page file, fly over it without
+// ticking and check every chunk comes back the way it was built, then fly over
+// and back while ticking and measure the frames, the waits and the memory
+static bool paging(int worldW, int worldH, int windowW, int windowH, int speed)
+{
+	const std::string path = "vixel_bench.pages";
+	const int size = CellGrid::CHUNK_SIZE;
+	ChunkPager pager;
+	if (!pager.open(path, worldW, worldH, windowW, windowH)) {
+		std::cerr << "Can't create " << path << std::endl;
+		return false;
+	}
+	std::vector<Material> tile(size * size);
+	std::vector<Material> expected(size * size);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int wcy = 0; wcy < pager.worldChunksY(); wcy++) {
+		for (int wcx = 0; wcx < pager.worldChunksX(); wcx++) {
+			fillWorldChunk(wcx, wcy, worldH, &tile[0]);
+			pager.store(wcx, wcy, &tile[0]);
+		}
+	}
+	double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// along the hills, where the water is
+	const int y = worldH / 2;
+	CellGrid grid;
+	pager.place(grid, 0, y / size - windowH / size / 2);
+	int mismatches = 0;
+	for (int x = 0; x < worldW; x += speed) {
+		int dcx;
+		int dcy;
+		if (!pager.follow(grid, x, y, dcx, dcy)) {
+			continue;
+		}
+		for (int cy = 0; cy < grid.chunksY(); cy++) {
+			for (int cx = 0; cx < grid.chunksX(); cx++) {
+				fillWorldChunk(pager.originX() + cx, pager.originY() + cy, worldH, &expected[0]);
+				if (memcmp(grid.tile(cx, cy), &expected[0], expected.size()) != 0) {
+					mismatches++;
+				}
+			}
+		}
+	}
+
+	Simulation simulation;
+	pager.place(grid, 0, y / size - windowH / size / 2);
+	std::vector<double> times;
+	size_t peak = 0;
+	int frame = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		for (int n = 0; n < worldW; n += speed, frame++) {
+			int x = (pass == 0) ? n : worldW - 1 - n;
+			auto before = std::chrono::steady_clock::now();
+			int dcx;
+			int dcy;
+			pager.follow(grid, x, y, dcx, dcy);
+			simulation.step(grid, frame);
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - before).count());
+			peak = std::max(peak, grid.memoryUsage() + pager.memoryUsage());
+		}
+	}
+	std::sort(times.begin(), times.end());
+
+	std::cout << "{\"check\": \"paging\""
+		<< ", \"world_width\": " << worldW
+		<< ", \"world_height\": " << worldH
+		<< ", \"window_width\": " << grid.width()
+		<< ", \"window_height\": " << grid.height()
+		<< ", \"build_ms\": " << buildMs
+		<< ", \"ticks\": " << frame
+		<< ", \"p50_ms\": " << percentile(times, 0.5)
+		<< ", \"p99_ms\": " << percentile(times, 0.99)
+		<< ", \"paged_out\": " << pager.pagedOut()
+		<< ", \"paged_in\": " << pager.pagedIn()
+		<< ", \"stalls\": " << pager.stalls()
+		<< ", \"stall_ms\": " << pager.stallSeconds() * 1000.0
+		<< ", \"world_bytes\": " << size_t(worldW) * worldH
+		<< ", \"peak_memory_bytes\": " << peak
+		<< ", \"page_file_bytes\": " << pager.fileBytes()
+		<< ", \"mismatches\": " << mismatches
+		<< ", \"write_errors\": " << pager.writeErrors()
+		<< "}" << std::endl;
+	return mismatches == 0 && pager.writeErrors() == 0;
+}
+
+// Save the busy scene every few ticks, then rewind all the way and compare every state
+static bool snapshots(int w, int h, int ticks, int every)
+{
+	CellGrid grid;
+	grid.resize(w, h);
+	fillScene(grid, 1);
+	Simulation simulation;
+
+	SimSnapshot ring;
+	ring.slots(ticks / every + 1);
+	std::vector<uint64_t> hashes;
+	ring.start(grid);
+	hashes.push_back(grid.hash());
+	for (int frame = 0; frame < ticks; frame++) {
+		simulation.step(grid, frame);
+		if ((frame + 1) % every == 0) {
+			ring.capture(grid);
+			hashes.push_back(grid.hash());
+		}
+	}
+	const int saved = ring.count();
+	const size_t bytes = ring.bytes();
+
+	int mismatch = -1;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int n = saved - 1; n >= 0; n--) {
+		ring.rewind(grid);
+		if (grid.hash() != hashes[n] && mismatch < 0) {
+			mismatch = n;
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	double us = std::chrono::duration<double, std::micro>(end - start).count() / saved;
+
+	std::cout << "{\"check\": \"snapshot\""
+		<< ", \"width\": " << w
+		<< ", \"height\": " << h
+		<< ", \"snapshots\": " << saved
+		<< ", \"every\": " << every
+		<< ", \"bytes\": " << bytes
+		<< ", \"bytes_per_snapshot\": " << double(bytes - 2 * grid.storage()) / (saved - 1)
+		<< ", \"us_per_rewind\": " << us
+		<< ", \"mismatch_at\": " << mismatch
+		<< "}" << std::endl;
+	return mismatch < 0;
+}
+
+int main(int argc, char* argv[])
+{
+	int threads = (int)std::thread::hardware_concurrency();
+	std::string levels = "assets/levels";
+	std::string recording;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc) {
+			levels = argv[++i];
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			recording = argv[++i];
+		}
+		else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+			if (!useRowKernel(argv[++i])) {
+				std::cerr << "This CPU can't run the " << argv[i] << " kernel." << std::endl;
+				return 1;
+			}
+		}
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	if (!recording.empty()) {
+		return replay(levels, recording) ? 0 : 1;
+	}
+
+	struct Size { int w, h, ticks; };
+	Size sizes[] = { { 160, 90, 2000 }, { 512, 512, 200 }, { 1024, 1024, 50 }, { 2048, 2048, 12 }, { 4096, 4096, 3 } };
+
+	bool ok = true;
+	bool same = true;
+	same &= determinism(Simulation::MODE_DOUBLE_BUFFER, "double_buffer", std::max(threads, 2), 640, 360, 100);
+	same &= determinism(Simulation::MODE_IN_PLACE, "in_place", std::max(threads, 2), 640, 360, 100);
+	same &= slicing(Simulation::MODE_DOUBLE_BUFFER, "double_buffer", threads, 2048, 2048, 40, 4.0);
+	same &= slicing(Simulation::MODE_IN_PLACE, "in_place", threads, 2048, 2048, 40, 4.0);
+	bool rewound = snapshots(160, 90, 2000, 10);
+	bool paged = paging(8192, 8192, 512, 512, 16);
+	bool counted = homeWatch(1024, 1024, 24, 400);
+	counted &= regions(threads, 1000, 600, 100, 200, false);
+	counted &= regions(threads, 1000, 600, 100, 200, true);
+
+	Scene scenes[] = { SCENE_BUSY, SCENE_QUIET, SCENE_SAND, SCENE_WATER, SCENE_FOREST };
+	for (Scene scene : scenes) {
+		for (Size& s : sizes) {
+			int counts[] = { 1, threads };
+			for (int c = 0; c < (threads > 1 ? 2 : 1); c++) {
+				ok &= benchmark(Simulation::MODE_DOUBLE_BUFFER, "double_buffer", scene, s.w, s.h, s.ticks, counts[c]);
+				ok &= benchmark(Simulation::MODE_IN_PLACE, "in_place", scene, s.w, s.h, s.ticks, counts[c]);
+			}
+		}
+	}
+	walkers(2048, 256, 600);
+	int level = 0;
+	while (levelBenchmark(levels, level, 2000)) {
+		level++;
+	}
+	if (level == 0) {
+		std::cerr << "No levels in " << levels << ", use --levels DIR." << std::endl;
+	}
+
+	if (!same) {
+		std::cerr << "A tick on more threads, or in slices, gave a different state." << std::endl;
+	}
+	if (!ok) {
+		std::cerr << "A tick allocated memory." << std::endl;
+	}
+	if (!rewound) {
+		std::cerr << "Rewinding gave a different state than was saved." << std::endl;
+	}
+	if (!paged) {
+		std::cerr << "A chunk came back from the page file different, or didn't get into it." << std::endl;
+	}
+	if (!counted) {
+		std::cerr << "The wood around a home, or the cells of a region, were counted wrong." << std::endl;
+	}
+	return (ok && same && rewound && paged && counted) ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include "characters.h"
+
+Characters::Characters()
+{
+
+}
+
+Characters::~Characters()
+{
+
+}
+
+void Characters::clear()
+{
+	x.clear();
+	y.clear();
+	startX.clear();
+	startY.clear();
+	width.clear();
+	height.clear();
+	direction.clear();
+	breath.clear();
+	airTime.clear();
+	fallSound.clear();
+	flags.clear();
+}
+
+int Characters::add(int posX, int posY, int w, int h)
+{
+	x.push_back(posX);
+	y.push_back(posY);
+	startX.push_back(posX);
+	startY.push_back(posY);
+	width.push_back(w);
+	height.push_back(h);
+	direction.push_back(1);
+	breath.push_back(16);
+	airTime.push_back(0);
+	fallSound.push_back(-1);
+	flags.push_back(0);
+	return int(x.size()) - 1;
+}
+
+void Characters::reset(size_t i)
+{
+	x[i] = startX[i];
+	y[i] = startY[i];
+	flags[i] &= ~CHARACTER_AWAKE;
+	direction[i] = 1;
+	breath[i] = 16;
+	airTime[i] = 0;
+	fallSound[i] = -1;
+}
+
+void Characters::die(size_t i)
+{
+	if (awake(i)) {
+		reset(i);
+	}
+}
+
+void Characters::move(int dx, int dy)
+{
+	for (size_t i = 0; i < x.size(); i++) {
+		x[i] += dx;
+		y[i] += dy;
+		startX[i] += dx;
+		startY[i] += dy;
+	}
+}
@@ -0,0 +1,90 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef CHARACTERS_H
+#define CHARACTERS_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+/// @brief Characters::flags bits
+enum CharacterFlag {
+	CHARACTER_AWAKE = 1, ///< @brief Walks, falls and breathes
+	CHARACTER_HOME = 2 ///< @brief Made it home, isn't drawn anymore
+};
+
+/// @brief All the characters of a level, an array per field.
+///
+/// Character i is element i of every array. The World runs every step of a tick
+/// over one or two of the arrays for all the characters at once, so a level
+/// with thousands of walkers reads memory front to back instead of a whole
+/// character at a time. Copying it (for a snapshot) copies the arrays.
+class Characters
+{
+public:
+	Characters(); ///< @brief Constructor of the Characters
+	virtual ~Characters(); ///< @brief Destructor of the Characters
+
+	std::vector<int> x; ///< @brief Left column
+	std::vector<int> y; ///< @brief Bottom row
+	std::vector<int> startX; ///< @brief Where the character starts and starts over when it dies, x
+	std::vector<int> startY; ///< @brief Where the character starts and starts over when it dies, y
+	std::vector<int> width; ///< @brief Width in cells
+	std::vector<int> height; ///< @brief Height in cells
+	std::vector<int> direction; ///< @brief 1 walks right, -1 left
+	std::vector<int> breath; ///< @brief Breath left under water
+	std::vector<int> airTime; ///< @brief Rows fallen since the character last stood on something
+	std::vector<int> fallSound; ///< @brief Voice of the fall sound, -1 when none
+	std::vector<uint8_t> flags; ///< @brief CharacterFlag bits
+
+	/// @brief Number of characters
+	/// @return size_t
+	size_t size() const { return x.size(); }
+	/// @brief Remove all characters
+	/// @return void
+	void clear();
+	/// @brief Add a character, asleep
+	/// @param posX Left column
+	/// @param posY Bottom row
+	/// @param w Width in cells
+	/// @param h Height in cells
+	/// @return int index of the character
+	int add(int posX, int posY, int w, int h);
+
+	bool awake(size_t i) const { return (flags[i] & CHARACTER_AWAKE) != 0; } ///< @brief Check if a character is awake
+	bool home(size_t i) const { return (flags[i] & CHARACTER_HOME) != 0; } ///< @brief Check if a character made it home
+	void wake(size_t i) { flags[i] |= CHARACTER_AWAKE; } ///< @brief Wake a character up
+
+	/// @brief Put a character back at its start, asleep
+	/// @param i Index
+	/// @return void
+	void reset(size_t i);
+	/// @brief Step one column in the direction the character walks
+	/// @param i Index
+	/// @return void
+	void walk(size_t i) { x[i] += direction[i]; }
+	/// @brief Fall one row
+	/// @param i Index
+	/// @return void
+	void fall(size_t i) { y[i]--; airTime[i]++; }
+	/// @brief Walk the other way
+	/// @param i Index
+	/// @return void
+	void turn(size_t i) { direction[i] = -direction[i]; }
+	/// @brief Start an awake character over
+	/// @param i Index
+	/// @return void
+	void die(size_t i);
+	/// @brief Move all characters, when the cells scroll
+	/// @param dx Columns to the right
+	/// @param dy Rows up
+	/// @return void
+	void move(int dx, int dy);
+};
+
+#endif /* CHARACTERS_H */
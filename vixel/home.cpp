@@ -16,6 +16,7 @@ Home::Home(int posX, int posY)
 	spriteH = 5;
 
 	active = false;
+	wood = 0;
 
 	init();
 }
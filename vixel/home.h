@@ -23,6 +23,7 @@ public:
 	int spriteW;
 	int spriteH;
 	bool active;
+	int wood;
 
 	void init();
 
@@ -0,0 +1,188 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include <cstring>
+#include <iterator>
+#include "inputrecording.h"
+
+static const char magic[4] = { 'V', 'X', 'I', 'N' };
+static const uint32_t version = 2;
+
+//the keys the game reads: reset, rewind, wake up, level down and up, fill and the materials
+static const int keys[InputRecording::KEYS] = { 'R', 'Z', 32, 91, 93, 'M', 49, 50, 51, 52, 53, 54, 55, 56, 57, 58 };
+
+static void put32(std::ofstream& out, uint32_t v)
+{
+	char b[4] = { char(v), char(v >> 8), char(v >> 16), char(v >> 24) };
+	out.write(b, 4);
+}
+
+static uint32_t get32(const uint8_t* in)
+{
+	return uint32_t(in[0]) | (uint32_t(in[1]) << 8) | (uint32_t(in[2]) << 16) | (uint32_t(in[3]) << 24);
+}
+
+static bool sameFrame(const InputFrame& a, const InputFrame& b)
+{
+	return a.mouseX == b.mouseX && a.mouseY == b.mouseY && a.buttons == b.buttons && a.scroll == b.scroll && a.keys == b.keys && a.ticks == b.ticks;
+}
+
+InputRecording::InputRecording()
+{
+	memset(&_last, 0, sizeof(_last));
+	_repeat = 0;
+	_read = 0;
+	_playing = false;
+	_seed = 0;
+	_level = 0;
+	_frameCount = 0;
+}
+
+InputRecording::~InputRecording()
+{
+	stop();
+}
+
+int InputRecording::key(int n)
+{
+	return keys[n];
+}
+
+uint32_t InputRecording::keyBit(int keyCode)
+{
+	for (int n = 0; n < KEYS; n++) {
+		if (keys[n] == keyCode) {
+			return 1u << n;
+		}
+	}
+	return 0;
+}
+
+bool InputRecording::record(const std::string& path, unsigned int seed, int level, int frameCount)
+{
+	stop();
+	_out.open(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!_out.is_open()) {
+		return false;
+	}
+	_seed = seed;
+	_level = level;
+	_frameCount = frameCount;
+	_repeat = 0;
+	_out.write(magic, 4);
+	put32(_out, version);
+	put32(_out, seed);
+	put32(_out, uint32_t(level));
+	put32(_out, uint32_t(frameCount));
+	return true;
+}
+
+void InputRecording::write(const InputFrame& frame)
+{
+	if (!recording()) {
+		return;
+	}
+	if (_repeat > 0 && sameFrame(frame, _last)) {
+		_repeat++;
+		return;
+	}
+	flush();
+	_last = frame;
+	_repeat = 1;
+}
+
+void InputRecording::flush()
+{
+	if (_repeat == 0) {
+		return;
+	}
+	uint32_t n = uint32_t(_repeat);
+	while (n >= 0x80) {
+		_out.put(char(n | 0x80));
+		n >>= 7;
+	}
+	_out.put(char(n));
+
+	char b[9];
+	b[0] = char(_last.mouseX);
+	b[1] = char(_last.mouseX >> 8);
+	b[2] = char(_last.mouseY);
+	b[3] = char(_last.mouseY >> 8);
+	b[4] = char(_last.buttons);
+	b[5] = char(_last.scroll);
+	b[6] = char(_last.keys);
+	b[7] = char(_last.keys >> 8);
+	b[8] = char(_last.ticks);
+	_out.write(b, 9);
+	_repeat = 0;
+}
+
+bool InputRecording::play(const std::string& path)
+{
+	stop();
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in.is_open()) {
+		return false;
+	}
+	_data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	if (_data.size() < 20 || memcmp(&_data[0], magic, 4) != 0 || get32(&_data[4]) != version) {
+		_data.clear();
+		return false;
+	}
+	_seed = get32(&_data[8]);
+	_level = int(get32(&_data[12]));
+	_frameCount = int(get32(&_data[16]));
+	_read = 20;
+	_repeat = 0;
+	_playing = true;
+	return true;
+}
+
+bool InputRecording::next(InputFrame& frame)
+{
+	if (!_playing) {
+		return false;
+	}
+	if (_repeat == 0) {
+		// the next run: its length, then the frame
+		uint32_t n = 0;
+		int shift = 0;
+		while (_read < _data.size() && (_data[_read] & 0x80)) {
+			n |= uint32_t(_data[_read++] & 0x7F) << shift;
+			shift += 7;
+		}
+		if (_read + 10 > _data.size() || (n == 0 && _data[_read] == 0)) {
+			stop();
+			return false;
+		}
+		n |= uint32_t(_data[_read++]) << shift;
+		const uint8_t* b = &_data[_read];
+		_last.mouseX = int16_t(b[0] | (b[1] << 8));
+		_last.mouseY = int16_t(b[2] | (b[3] << 8));
+		_last.buttons = b[4];
+		_last.scroll = int8_t(b[5]);
+		_last.keys = uint32_t(b[6]) | (uint32_t(b[7]) << 8);
+		_last.ticks = b[8];
+		_read += 9;
+		_repeat = int(n);
+	}
+	_repeat--;
+	frame = _last;
+	return true;
+}
+
+void InputRecording::stop()
+{
+	if (_out.is_open()) {
+		flush();
+		_out.close();
+	}
+	_playing = false;
+	_data.clear();
+	_read = 0;
+	_repeat = 0;
+}
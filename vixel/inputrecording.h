@@ -0,0 +1,104 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef INPUTRECORDING_H
+#define INPUTRECORDING_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+
+/// @brief InputFrame button bits
+enum InputButton {
+	INPUT_MOUSE_LEFT = 1, ///< @brief Left mouse button held
+	INPUT_MOUSE_LEFT_UP = 2, ///< @brief Left mouse button released this frame
+	INPUT_MOUSE_RIGHT = 4 ///< @brief Right mouse button held
+};
+
+/// @brief Everything the Game reads from the Input during one update
+struct InputFrame
+{
+	int mouseX; ///< @brief Mouse x in canvas pixels
+	int mouseY; ///< @brief Mouse y in canvas pixels
+	int buttons; ///< @brief InputButton bits
+	int scroll; ///< @brief Scrolled amount
+	uint32_t keys; ///< @brief Bit n set: InputRecording::key(n) went down this frame
+	int ticks; ///< @brief Fixed ticks the game ran this frame
+};
+
+/// @brief Records the input of the Game to a file, or plays a recording back.
+///
+/// A frame is only what the Game reads from the Input, plus how many fixed
+/// ticks the game ran, so playing it back with the same seed and level gives the same game
+/// every time however fast it runs. Frames that repeat (nobody touches
+/// anything) are stored once with a count.
+///
+/// File: "VXIN", version, seed, level, frame count, then (repeat count, frame)
+/// runs. Numbers are little endian, counts 7 bits per byte.
+class InputRecording
+{
+public:
+	InputRecording(); ///< @brief Constructor of the InputRecording
+	virtual ~InputRecording(); ///< @brief Destructor of the InputRecording, finishes the file
+
+	static const int KEYS = 16; ///< @brief Number of keys a frame holds
+	/// @brief Key code of a key a frame holds
+	/// @param n 0 to KEYS - 1
+	/// @return int KeyCode
+	static int key(int n);
+	/// @brief Bit of a key in InputFrame::keys
+	/// @param keyCode KeyCode
+	/// @return uint32_t 0 when a frame doesn't hold the key
+	static uint32_t keyBit(int keyCode);
+
+	/// @brief Start recording to a file
+	/// @param path File
+	/// @param seed Seed of the simulation
+	/// @param level Level the recording starts in
+	/// @param frameCount Frames since the start of the game
+	/// @return bool false when the file can't be written
+	bool record(const std::string& path, unsigned int seed, int level, int frameCount);
+	/// @brief Add a frame to the recording
+	/// @param frame Input
+	/// @return void
+	void write(const InputFrame& frame);
+	/// @brief Load a recording to play back
+	/// @param path File
+	/// @return bool false when the file can't be read or isn't a recording
+	bool play(const std::string& path);
+	/// @brief Get the next frame of the recording that plays
+	/// @param frame Input out
+	/// @return bool false at the end, playing() is false from then on
+	bool next(InputFrame& frame);
+	/// @brief Stop recording or playing, finishes the file
+	/// @return void
+	void stop();
+
+	bool recording() const { return _out.is_open(); } ///< @brief Check if frames go to a file
+	bool playing() const { return _playing; } ///< @brief Check if a recording plays
+	unsigned int seed() const { return _seed; } ///< @brief Seed of the recording
+	int level() const { return _level; } ///< @brief Level the recording starts in
+	int frameCount() const { return _frameCount; } ///< @brief Frames since the start of the game when the recording started
+
+private:
+	/// @brief Write the run of repeating frames
+	/// @return void
+	void flush();
+
+	std::ofstream _out; ///< @brief File being recorded
+	InputFrame _last; ///< @brief Last frame written, or read
+	int _repeat; ///< @brief Times _last repeats, not written yet
+	std::vector<uint8_t> _data; ///< @brief Recording being played
+	size_t _read; ///< @brief Read position in _data
+	bool _playing; ///< @brief A recording plays
+	unsigned int _seed; ///< @brief Seed of the simulation
+	int _level; ///< @brief Level the recording starts in
+	int _frameCount; ///< @brief Frames since the start of the game when the recording started
+};
+
+#endif /* INPUTRECORDING_H */
@@ -5,18 +5,29 @@
  *     - Initial commit
  */
 
+#include <cstring>
 #include <lavendframework/core.h>
 
 #include "game.h"
 
-int main( void )
+int main( int argc, char* argv[] )
 {
 	// Core instance
 	Core core;
 
 	// Create all scenes on the heap and keep a list
 	std::vector<SuperScene*> scenes;
-	scenes.push_back(new Game()); // canvas space invaders
+	Game* game = new Game();
+	// --record file: save the input, --replay file: play it back as fast as possible
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--record") == 0) {
+			game->record(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--replay") == 0) {
+			game->replay(argv[++i]);
+		}
+	}
+	scenes.push_back(game); // canvas space invaders
 	int s = scenes.size();
 
 	// start running with the first Scene
@@ -0,0 +1,438 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ */
+
+#include "session.h"
+#include "sim/rowkernels.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+const uint8_t Session::palette[MATERIALS][3] = {
+	{ 0, 0, 0 }, //air 0
+	{ 116, 63, 57 }, //dirt 1
+	{ 230, 177, 133 }, //wood 2
+	{ 100, 100, 100 }, //stone 3
+	{ 228, 59, 68 }, //fire 4
+	{ 247, 118, 34 }, //lava 5
+	{ 0, 149, 233 }, //water 6
+	{ 99, 199, 77 }, //acid 7
+	{ 182, 83, 212 }, //character 8
+	{ 62, 137, 72 }, //grass 9
+	{ 102, 11, 111 }, //home inactive 10
+	{ 210, 66, 210 }, //home active 11
+	{ 84, 84, 84 }, //dark stone 12
+	{ 60, 60, 135 } //indestructible 13
+};
+
+Session::Session()
+{
+	levels = "assets/levels";
+	width = 0;
+	height = 0;
+	currentMaterial = 1;
+	useableMaterialsCap = 8;
+	scrolledAmount = 0;
+	frameCount = 0;
+	hasClicked = false;
+	onLastLevel = false;
+	allMaterialsDisabled = false;
+	frameInput.mouseX = 0;
+	frameInput.mouseY = 0;
+	frameInput.buttons = 0;
+	frameInput.scroll = 0;
+	frameInput.keys = 0;
+	frameInput.ticks = 0;
+	wholeTicks = 0;
+	wholeTickSeconds = 0.0;
+	pendingTicks = 0;
+
+	level = 0;
+
+	snapshotEntities.resize(snapshots.slots());
+}
+
+Session::~Session()
+{
+
+}
+
+void Session::start(int w, int h)
+{
+	width = w;
+	height = h;
+	initLevel();
+}
+
+int Session::runFrame(const InputFrame& frame, bool whole)
+{
+	frameInput = frame;
+
+	//update stuff, the cells are whole pixels so there's nothing to interpolate with fixedStep()->alpha().
+	//A tick of a big level may take a few frames, the screen shows the last whole tick until it's done.
+	//Recordings run whole ticks, so they play back the same
+	pendingTicks = std::min(pendingTicks + frame.ticks, MAX_CATCH_UP);
+	int ticks = 0;
+	auto frameStart = std::chrono::steady_clock::now();
+	while (pendingTicks > 0) {
+		if (whole) {
+			auto start = std::chrono::steady_clock::now();
+			world.updateField(frameCount);
+			wholeTickSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			wholeTicks++;
+		}
+		else {
+			double left = SIM_BUDGET_MS / 1000.0 - std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+			if (ticks > 0 && left <= 0) {
+				break;
+			}
+			if (!world.updateField(frameCount, std::max(left, 0.0))) {
+				break;
+			}
+		}
+		world.updateHomes();
+		world.updateCharacters(frameCount);
+		ticked();
+		checkLevelProgress();
+
+		if (frameCount % SNAPSHOT_FRAMES == 0) {
+			saveEntities(snapshotEntities[snapshots.capture(world.cells)]);
+		}
+
+		frameCount++;
+		pendingTicks--;
+		ticks++;
+	}
+
+	int mousex = frame.mouseX;
+	int mousey = frame.mouseY;
+
+	bool clickedOnUI = false;
+	//place material left click
+	if (frame.buttons & INPUT_MOUSE_LEFT) {
+
+		//check if the player clicks on the main menu start button
+		if (level == 0 && !hasClicked) {
+			if (mousex >= 48 && mousex <= 98 && mousey >= 19 && mousey <= 34) {
+				level++;
+				initLevel();
+			}
+		}
+
+		//check if the player clicks on material ui
+		for (int m = 0; m < useableMaterialsCap; m++)
+		{
+			if (!hasClicked) {
+				//check if the mouse is on a material ui button
+				int uiLocX = width - 2 * m - 5;
+				int uiLocY = height - 6;
+
+				if (mousex == uiLocX || mousex == uiLocX + 1) {
+					if (mousey == uiLocY || mousey == uiLocY + 1) {
+						//set material (if not disabled in level)
+						if (!(std::find(disabledMaterials.begin(), disabledMaterials.end(), useableMaterialsCap - m - 1) != disabledMaterials.end())) {
+							currentMaterial = useableMaterialsCap - m - 1;
+						}
+						clickedOnUI = true;
+					}
+				}
+			}
+		}
+		if (!clickedOnUI && !allMaterialsDisabled) { //draw
+			this->placePixel(int(mousex), int(mousey), currentMaterial, 2);
+		}
+		hasClicked = true;
+	}
+	//reset hasClicked
+	if (frame.buttons & INPUT_MOUSE_LEFT_UP) {
+		clickedOnUI = false;
+		hasClicked = false;
+	}
+	//place air
+	if (frame.buttons & INPUT_MOUSE_RIGHT) { //right mouse button
+		this->placePixel(mousex, mousey, 0, 1);
+	}
+	//reset key
+	if (keyDown('R')) {
+		restartLevel();
+	}
+	//rewind key
+	if (keyDown('Z')) {
+		rewind();
+	}
+	//wakeup all characters
+	if (keyDown(32)) { //spacebar
+		for (size_t c = 0; c < world.characters.size(); c++) {
+			world.characters.wake(c);
+		}
+	}
+	//increase or decrease level
+	if (keyDown(91)) { //left bracket [
+		if (level > 0) {
+			level--;
+			initLevel();
+		}
+	}
+	else if (keyDown(93)) { //right bracket ]
+		if (!onLastLevel) {
+			level++;
+			initLevel();
+		}
+	}
+	//fill key
+	if (keyDown('M')) {
+		if (!allMaterialsDisabled) {
+			fill(currentMaterial);
+		}
+	}
+	//change material on scroll
+	if (frame.scroll != 0) {
+		scrolledAmount += frame.scroll;
+
+		moveToSelectableMat();
+	}
+	//select material on number key press
+	for (int i = 0; i <= 9; i++)
+	{
+		if (keyDown(49 + i) && i < useableMaterialsCap) { // KeyCode 49 is Alpha1
+
+			if (!(std::find(disabledMaterials.begin(), disabledMaterials.end(), i) != disabledMaterials.end())) {
+				currentMaterial = i;
+			}
+		}
+	}
+	return ticks;
+}
+
+void Session::moveToSelectableMat() {
+	int unavailableAmount = 0;
+	while (unavailableAmount <= useableMaterialsCap - 1 && (std::find(disabledMaterials.begin(), disabledMaterials.end(), scrolledAmount) != disabledMaterials.end())) {
+		unavailableAmount++;
+		if (frameInput.scroll > 0) {
+			scrolledAmount++;
+		}
+		else {
+			scrolledAmount--;
+		}
+		if (scrolledAmount < 0) {
+			scrolledAmount = useableMaterialsCap - 1;
+		}
+		if (scrolledAmount > useableMaterialsCap - 1) {
+			scrolledAmount = 0;
+		}
+	}
+
+	if (scrolledAmount < 0) {
+		scrolledAmount = useableMaterialsCap - 1;
+	}
+	if (scrolledAmount > useableMaterialsCap - 1) {
+		scrolledAmount = 0;
+	}
+
+	currentMaterial = scrolledAmount;
+}
+
+void Session::initLevel() {
+	//reset level
+	world.simulation.cancel(world.cells);
+	world.cells.resize(width, height);
+
+	disabledMaterials.clear();
+	checkDisabledMaterials();
+	moveToSelectableMat();
+
+	levelStarting();
+	loadLevel();
+
+	for (int i = 0; i < useableMaterialsCap; i++)
+	{
+		int posx = width - 2 * i - 5;
+		int posy = height - 6;
+		placePixel(posx, posy, 13, 1);
+		placePixel(posx + 1, posy, 13, 1);
+		placePixel(posx, posy + 1, 13, 1);
+		placePixel(posx + 1, posy + 1, 13, 1);
+	}
+
+	//the start of the level, to restart and rewind to without loading it again
+	saveEntities(levelStart);
+	saveEntities(snapshotEntities[snapshots.start(world.cells)]);
+}
+
+void Session::restartLevel() {
+	world.simulation.cancel(world.cells);
+	int slot = snapshots.restart(world.cells);
+	if (slot < 0) {
+		initLevel();
+		return;
+	}
+	loadEntities(levelStart);
+	saveEntities(snapshotEntities[slot]);
+}
+
+void Session::rewind() {
+	world.simulation.cancel(world.cells);
+	int slot = snapshots.rewind(world.cells);
+	if (slot >= 0) {
+		loadEntities(snapshotEntities[slot]);
+	}
+}
+
+void Session::saveEntities(Entities& e) {
+	e.characters = world.characters;
+	e.homes = world.homes;
+	e.frameCount = frameCount;
+}
+
+void Session::loadEntities(const Entities& e) {
+	world.characters = e.characters;
+	world.homes = e.homes;
+	world.placeCharacters();
+	world.watchHomes();
+	frameCount = e.frameCount;
+}
+
+void Session::checkDisabledMaterials() {
+	disabledMaterials.clear();
+	std::string line;
+	std::ifstream levelInfo(levels + "/disabled_materials.txt");
+
+	if (levelInfo.is_open())
+	{
+		while (std::getline(levelInfo, line))
+		{
+			bool levelIndexFound = false;
+			std::string levelIndexString = "";
+			int levelIndex = 0;
+			std::string disabledMatString = "";
+
+			for (char& c : line) {
+				//stop if : is found
+				if (c == ':') {
+					levelIndexFound = true;
+				}
+				//add character to level index
+				if (!levelIndexFound) {
+					levelIndexString += c;
+				}
+				//add characters to disabled materials list
+				else if (c != ':' && c != ' ') {
+					disabledMatString += c;
+				}
+			}
+			std::istringstream(levelIndexString) >> levelIndex;
+
+			if (levelIndex == level) {
+
+				std::string matNumber;
+				for (char& c : disabledMatString) {
+					//split the numbers
+					if (c != ',') {
+						matNumber += c;
+					}
+					else {
+						//add disabled material number to the array
+						int number = 0;
+						std::istringstream(matNumber) >> number;
+						disabledMaterials.push_back(number);
+						matNumber = "";
+					}
+				}
+			}
+		}
+		levelInfo.close();
+	}
+
+	allMaterialsDisabled = false;
+	for (int b = 0; b < disabledMaterials.size(); b++)
+	{
+		if (b > useableMaterialsCap - 1) {
+			allMaterialsDisabled = true;
+		}
+	}
+}
+
+void Session::checkLevelProgress() {
+
+	if (world.characters.size() != 0) {
+		int chraractersHome = 0;
+
+		for (size_t c = 0; c < world.characters.size(); c++) {
+			if (world.characters.home(c)) {
+				chraractersHome++;
+			}
+		}
+		//next level if all character are home
+		if (chraractersHome >= world.characters.size()) {
+			level++;
+			initLevel();
+	}
+	}
+}
+
+void Session::loadLevel() {
+
+	int w;
+	int h;
+	int bytesPerPixel;
+	std::vector<uint8_t> pixels;
+
+	//prevent out of bounds error by loading specific level
+	onLastLevel = false;
+	if (!readLevelImage(levels + "/level" + std::to_string(level) + ".tga", w, h, bytesPerPixel, pixels)) {
+		onLastLevel = true;
+		if (!readLevelImage(levels + "/ooblevel.tga", w, h, bytesPerPixel, pixels)) {
+			std::cout << "Can't read the levels in " << levels << std::endl;
+			return;
+		}
+	}
+	if (w != width || h != height) {
+		//world.load() reads the image as if it's the size of the grid
+		std::cout << "Level " << level << " is " << w << "x" << h << ", not " << width << "x" << height << std::endl;
+		return;
+	}
+	world.load(&pixels[0], bytesPerPixel, palette, MATERIALS);
+}
+
+void Session::placePixel(int x, int y, int mat, int size) {
+
+	//the grid checks the bounds, -1 when outside
+	int pos = world.cells.id(x, y);
+	if (pos != -1 && world.cells[pos] != 13) {
+		if (!world.cells.occupied(pos)) { //not under a character
+			world.cells.material(pos, mat);
+		}
+
+		if (size > 1) {
+			placePixel(x - 1, y, mat);
+			placePixel(x + 1, y, mat);
+			placePixel(x, y - 1, mat);
+			placePixel(x, y + 1, mat);
+		}
+	}
+}
+
+void Session::fill(int mat) {
+	//only the chunks with air and only their air cells
+	uint32_t rows[CellGrid::CHUNK_SIZE];
+	for (int cy = 0; cy < world.cells.chunksY(); cy++) {
+		for (int cx = 0; cx < world.cells.chunksX(); cx++) {
+			if (!world.cells.materialRows(cx, cy, 1u << MAT_AIR, rows)) {
+				continue;
+			}
+			for (int y = 0; y < CellGrid::CHUNK_SIZE; y++) {
+				for (uint32_t bits = rows[y]; bits != 0; bits &= bits - 1) {
+					int i = world.cells.id(cx * CellGrid::CHUNK_SIZE + lowestBit(bits), cy * CellGrid::CHUNK_SIZE + y);
+					if (!world.cells.occupied(i)) {
+						world.cells.material(i, mat);
+					}
+				}
+			}
+		}
+	}
+}
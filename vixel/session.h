@@ -0,0 +1,127 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "inputrecording.h"
+#include "world.h"
+#include "sim/snapshot.h"
+
+/// @brief A game of Vixel without a window: the levels, what the input does to them and when they tick.
+/// The Game draws it and plays its sounds, vixel_bench plays recordings with it headless
+class Session
+{
+public:
+	Session(); ///< @brief Constructor of the Session
+	virtual ~Session(); ///< @brief Destructor of the Session
+
+	static const int MATERIALS = 14; ///< @brief Number of materials the levels use
+	static const uint8_t palette[MATERIALS][3]; ///< @brief The color of every material in the level images
+	static const int MAX_CATCH_UP = 4; ///< @brief Most ticks a frame runs to catch up
+
+	/// @brief Start the game at the level that's set
+	/// @param w Width of the screen in cells
+	/// @param h Height of the screen in cells
+	/// @return void
+	void start(int w, int h);
+	/// @brief Run one frame of the game: tick if it's time, then handle the input
+	/// @param frame The input, read or played back
+	/// @param whole Run every tick whole, the way a recording has to, or stop at SIM_BUDGET_MS and go on next frame
+	/// @return int The ticks that were done
+	int runFrame(const InputFrame& frame, bool whole);
+
+	World world; ///< @brief The pixels, characters and homes of the current level
+	std::string levels; ///< @brief Where the level*.tga files and disabled_materials.txt are
+	int frameCount; ///< @brief Frames since the start of the game
+	int level; ///< @brief Currently selected level
+	int wholeTicks; ///< @brief Whole ticks runFrame() did
+	double wholeTickSeconds; ///< @brief Time the simulation took during the whole ticks
+
+protected:
+	/// @brief Called after every tick, the sounds of the tick are in world.sounds
+	/// @return void
+	virtual void ticked() {}
+	/// @brief Called when a level is about to load, the characters of the last one are still there
+	/// @return void
+	virtual void levelStarting() {}
+
+	/// @brief Check if a key went down this frame, the key has to be one InputRecording holds
+	inline bool keyDown(int key) { return (frameInput.keys & InputRecording::keyBit(key)) != 0; }
+
+	int width; ///< @brief Width of the screen in cells
+	int height; ///< @brief Height of the screen in cells
+	int currentMaterial; ///< @brief The currently selected material
+	int useableMaterialsCap; ///< @brief Caps the materials the player can use
+	int scrolledAmount; ///< @brief Scrolled amount
+	bool onLastLevel; ///< @brief Check if the player is on the last level
+	bool hasClicked; ///< @brief Check if the player has held down the mouse button
+	bool allMaterialsDisabled; ///< @brief Check for if all the materials available are disabled
+	std::vector<int> disabledMaterials; ///< @brief The materials the player can't use in this level
+
+	/// @brief What a snapshot of the level needs besides the pixels
+	struct Entities
+	{
+		Characters characters; ///< @brief The characters
+		std::vector<Home> homes; ///< @brief The homes
+		int frameCount; ///< @brief Frames since the start of the game
+	};
+	static const int SNAPSHOT_FRAMES = 30; ///< @brief Frames between two snapshots
+	SimSnapshot snapshots; ///< @brief Earlier states of the level, to rewind to
+	std::vector<Entities> snapshotEntities; ///< @brief The characters and homes of every snapshot slot
+	Entities levelStart; ///< @brief The characters and homes at the start of the level
+
+	static const int SIM_BUDGET_MS = 8; ///< @brief Time the simulation may take per frame, a longer tick goes on next frame
+	int pendingTicks; ///< @brief Ticks the FixedStep asked for that didn't run yet
+	InputFrame frameInput; ///< @brief The input of the current frame
+
+	/// @brief Initialize the level: load the level image and reset all values to the default
+	/// @return void
+	void initLevel();
+	/// @brief Restart the level from its snapshot, or load it again when there's none
+	/// @return void
+	void restartLevel();
+	/// @brief Go back to the last snapshot, every next call goes back one more
+	/// @return void
+	void rewind();
+	/// @brief Save the characters and homes along with a snapshot
+	/// @param e Where to save them
+	/// @return void
+	void saveEntities(Entities& e);
+	/// @brief Restore the characters and homes of a snapshot
+	/// @param e Saved by saveEntities()
+	/// @return void
+	void loadEntities(const Entities& e);
+	/// @brief Move the next available material when scrolling
+	/// @return void
+	void moveToSelectableMat();
+	/// @brief Check the levels.txt file if the current level has any materials disabled
+	/// @return void
+	void checkDisabledMaterials();
+	/// @brief Loop over all the characters to see if all of them are home. If so, move to the next level
+	/// @return void
+	void checkLevelProgress();
+	/// @brief Place a pixel at the given location with a given material with size 1 or 2
+	/// @param x X
+	/// @param y Y
+	/// @param mat Material
+	/// @param size Brush size
+	/// @return void
+	void placePixel(int x, int y, int mat, int size = 1);
+	/// @brief Fill the air of the level with a material, apart from the cells under a character
+	/// @param mat Material
+	/// @return void
+	void fill(int mat);
+	/// @brief Load the level image into the world, its characters and homes included
+	/// @return void
+	void loadLevel();
+};
+
+#endif /* SESSION_H */
@@ -0,0 +1,592 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "cellgrid.h"
+#include "rowkernels.h"
+
+static const CellGrid::Rect emptyRect = { 0, 0, -1, -1 };
+
+/// @brief Grow a rectangle so it also covers another one
+static inline void merge(CellGrid::Rect& r, const CellGrid::Rect& o)
+{
+	if (o.empty()) {
+		return;
+	}
+	if (r.empty()) {
+		r = o;
+		return;
+	}
+	r.x0 = std::min(r.x0, o.x0);
+	r.y0 = std::min(r.y0, o.y0);
+	r.x1 = std::max(r.x1, o.x1);
+	r.y1 = std::max(r.y1, o.y1);
+}
+
+CellGrid::CellGrid()
+{
+	_width = 0;
+	_height = 0;
+	_size = 0;
+	_storage = 0;
+	_tick = 0;
+	_keepEdits = false;
+	_inTick = false;
+	_trackChanges = false;
+	_chunksX = 0;
+	_chunksY = 0;
+	_awakeChunks = 0;
+	_ticks = 0;
+}
+
+CellGrid::~CellGrid()
+{
+
+}
+
+void CellGrid::resize(int width, int height)
+{
+	_chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	_chunksY = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	size_t chunks = size_t(_chunksX) * size_t(_chunksY);
+
+	// whole tiles, so every chunk is one block of memory
+	size_t storage = chunks * CHUNK_SIZE * CHUNK_SIZE;
+	if (storage != _storage) {
+		_cells.assign(storage, 0);
+		_next.assign(storage, 0);
+		_parity.assign(storage, 0);
+	}
+	else {
+		std::fill(_cells.begin(), _cells.end(), 0);
+		std::fill(_next.begin(), _next.end(), 0);
+		std::fill(_parity.begin(), _parity.end(), 0);
+	}
+	_width = width;
+	_height = height;
+	_size = size_t(width) * size_t(height);
+	_storage = storage;
+	_tick = 0;
+	_ticks = 0;
+	_keepEdits = false;
+	_inTick = false;
+
+	_dirty.assign(chunks, emptyRect);
+	_recent.assign(chunks, emptyRect);
+	_older.assign(chunks, emptyRect);
+	_active.assign(chunks, emptyRect);
+	_present.assign(chunks, 0u);
+	_stale.assign(chunks, 1);
+	_changed.assign(chunks, emptyRect);
+	_changedChunks.clear();
+	_changedChunks.reserve(chunks);
+	_listed.assign(chunks * LIST_CAPACITY, 0);
+	_listedNext.assign(chunks * LIST_CAPACITY, 0);
+	_listedCount.assign(chunks, 0);
+	_listedNextCount.assign(chunks, 0);
+	_awakeChunks = 0;
+	wakeAll();
+
+	if (_lifetime.allocated()) {
+		_lifetime.allocate(storage);
+	}
+	if (_temperature.allocated()) {
+		_temperature.allocate(storage);
+	}
+	if (_wetness.allocated()) {
+		_wetness.allocate(storage);
+	}
+	if (_occupied.allocated()) {
+		_occupied.allocate(storage >> CHUNK_SHIFT);
+	}
+}
+
+void CellGrid::assign(const std::vector<int>& cells)
+{
+	size_t count = std::min(cells.size(), _size);
+	for (size_t i = 0; i < count; i++) {
+		_cells[id(int(i % _width), int(i / _width))] = Material(cells[i]);
+	}
+	wakeAll();
+}
+
+void CellGrid::load(const Material* cells)
+{
+	memcpy(&_cells[0], cells, _storage);
+	wakeAll();
+}
+
+/// @brief Move per-chunk data along with a scroll: chunk (cx, cy) gets what chunk (cx + dcx, cy + dcy)
+/// had, chunks that had nothing there get vacant
+template<class T>
+static void scrollChunks(T* data, size_t perChunk, int chunksX, int chunksY, int dcx, int dcy, T vacant)
+{
+	const int chunks = chunksX * chunksY;
+	const int offset = dcy * chunksX + dcx;
+	for (int n = 0; n < chunks; n++) {
+		// go the way the data moves, so nothing is overwritten before it's read
+		int c = (offset >= 0) ? n : chunks - 1 - n;
+		int sx = c % chunksX + dcx;
+		int sy = c / chunksX + dcy;
+		T* dst = data + size_t(c) * perChunk;
+		if (sx >= 0 && sx < chunksX && sy >= 0 && sy < chunksY) {
+			const T* src = data + size_t(sy * chunksX + sx) * perChunk;
+			std::copy(src, src + perChunk, dst);
+		}
+		else {
+			std::fill(dst, dst + perChunk, vacant);
+		}
+	}
+}
+
+void CellGrid::scroll(int dcx, int dcy)
+{
+	if (dcx == 0 && dcy == 0) {
+		return;
+	}
+	const size_t tile = CHUNK_SIZE * CHUNK_SIZE;
+	scrollChunks(&_cells[0], tile, _chunksX, _chunksY, dcx, dcy, Material(0));
+	if (_lifetime.allocated()) {
+		scrollChunks(_lifetime.data(), tile, _chunksX, _chunksY, dcx, dcy, uint8_t(0));
+	}
+	if (_temperature.allocated()) {
+		scrollChunks(_temperature.data(), tile, _chunksX, _chunksY, dcx, dcy, int16_t(0));
+	}
+	if (_wetness.allocated()) {
+		scrollChunks(_wetness.data(), tile, _chunksX, _chunksY, dcx, dcy, uint8_t(0));
+	}
+	if (_occupied.allocated()) {
+		scrollChunks(_occupied.data(), CHUNK_SIZE, _chunksX, _chunksY, dcx, dcy, uint32_t(0));
+	}
+
+	// what the next tick visits moves along, the lists are positions inside the chunk
+	scrollChunks(&_dirty[0], 1, _chunksX, _chunksY, dcx, dcy, emptyRect);
+	scrollChunks(&_recent[0], 1, _chunksX, _chunksY, dcx, dcy, emptyRect);
+	scrollChunks(&_older[0], 1, _chunksX, _chunksY, dcx, dcy, emptyRect);
+	scrollChunks(&_listedNext[0], LIST_CAPACITY, _chunksX, _chunksY, dcx, dcy, uint16_t(0));
+	scrollChunks(&_listedNextCount[0], 1, _chunksX, _chunksY, dcx, dcy, 0);
+	std::fill(_stale.begin(), _stale.end(), 1);
+	clearChanges();
+	const int sx = dcx * CHUNK_SIZE;
+	const int sy = dcy * CHUNK_SIZE;
+	for (size_t c = 0; c < _dirty.size(); c++) {
+		Rect* rects[] = { &_dirty[c], &_recent[c], &_older[c] };
+		for (Rect* r : rects) {
+			if (!r->empty()) {
+				r->x0 -= sx;
+				r->y0 -= sy;
+				r->x1 = std::min(r->x1 - sx, _width - 1);
+				r->y1 = std::min(r->y1 - sy, _height - 1);
+			}
+		}
+	}
+}
+
+void CellGrid::loadTile(int cx, int cy, const Material* cells)
+{
+	memcpy(&_cells[size_t(cy * _chunksX + cx) << (2 * CHUNK_SHIFT)], cells, CHUNK_SIZE * CHUNK_SIZE);
+	Rect area;
+	area.x0 = cx * CHUNK_SIZE;
+	area.y0 = cy * CHUNK_SIZE;
+	area.x1 = std::min(area.x0 + CHUNK_SIZE, _width) - 1;
+	area.y1 = std::min(area.y0 + CHUNK_SIZE, _height) - 1;
+	wake(grow(area), &_dirty[0]);
+	_stale[cy * _chunksX + cx] = 1;
+}
+
+void CellGrid::usePlane(Plane plane)
+{
+	switch (plane) {
+		case PLANE_LIFETIME:
+			if (!_lifetime.allocated()) {
+				_lifetime.allocate(_storage);
+			}
+			break;
+		case PLANE_TEMPERATURE:
+			if (!_temperature.allocated()) {
+				_temperature.allocate(_storage);
+			}
+			break;
+		case PLANE_WETNESS:
+			if (!_wetness.allocated()) {
+				_wetness.allocate(_storage);
+			}
+			break;
+	}
+}
+
+void CellGrid::moveMetadata(int from, int to)
+{
+	if (_lifetime.allocated()) {
+		_lifetime[to] = _lifetime[from];
+		_lifetime[from] = 0;
+	}
+	if (_temperature.allocated()) {
+		_temperature[to] = _temperature[from];
+		_temperature[from] = 0;
+	}
+	if (_wetness.allocated()) {
+		_wetness[to] = _wetness[from];
+		_wetness[from] = 0;
+	}
+}
+
+void CellGrid::occupy(const Rect& area, bool on)
+{
+	Rect r;
+	r.x0 = std::max(area.x0, 0);
+	r.y0 = std::max(area.y0, 0);
+	r.x1 = std::min(area.x1, _width - 1);
+	r.y1 = std::min(area.y1, _height - 1);
+	if (r.empty() || r.y0 > r.y1) {
+		return;
+	}
+	if (!_occupied.allocated()) {
+		_occupied.allocate(_storage >> CHUNK_SHIFT);
+	}
+	// a run is part of one row of a tile, that's part of one word
+	forEachRun(r, [this, on](int i, int x, int y, int count) {
+		uint32_t bits = ((count == CHUNK_SIZE) ? ~0u : (1u << count) - 1) << (i & CHUNK_MASK);
+		uint32_t& row = _occupied[size_t(i) >> CHUNK_SHIFT];
+		row = on ? (row | bits) : (row & ~bits);
+	});
+}
+
+uint32_t CellGrid::chunkMaterials(int cx, int cy)
+{
+	int c = cy * _chunksX + cx;
+	if (_inTick) {
+		// what a tick changes is only merged at its end, the chunks it visits and
+		// their margins may have changed since they were counted
+		for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, _chunksY - 1); y++) {
+			for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, _chunksX - 1); x++) {
+				if (awake(x, y)) {
+					return tileMaterials(tile(cx, cy));
+				}
+			}
+		}
+	}
+	if (_stale[c]) {
+		_present[c] = tileMaterials(tile(cx, cy));
+		_stale[c] = 0;
+	}
+	return _present[c];
+}
+
+bool CellGrid::materialRows(int cx, int cy, uint32_t materials, uint32_t* rows)
+{
+	if ((chunkMaterials(cx, cy) & materials) == 0) {
+		std::fill(rows, rows + CHUNK_SIZE, 0u);
+		return false;
+	}
+	visitMask(tile(cx, cy), ~materials, rows);
+	// the padding of the last column and row of chunks isn't part of the grid
+	const int w = std::min(_width - cx * CHUNK_SIZE, int(CHUNK_SIZE));
+	const int h = std::min(_height - cy * CHUNK_SIZE, int(CHUNK_SIZE));
+	const uint32_t columns = (w == CHUNK_SIZE) ? ~0u : (1u << w) - 1;
+	bool found = false;
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		rows[y] = (y < h) ? rows[y] & columns : 0;
+		found |= rows[y] != 0;
+	}
+	return found;
+}
+
+template<class F>
+bool CellGrid::forEachMaterialChunk(const Rect& area, uint32_t materials, F f)
+{
+	const int x0 = std::max(area.x0, 0);
+	const int y0 = std::max(area.y0, 0);
+	const int x1 = std::min(area.x1, _width - 1);
+	const int y1 = std::min(area.y1, _height - 1);
+	if (x0 > x1 || y0 > y1) {
+		return false;
+	}
+	uint32_t rows[CHUNK_SIZE];
+	for (int cy = y0 >> CHUNK_SHIFT; cy <= y1 >> CHUNK_SHIFT; cy++) {
+		for (int cx = x0 >> CHUNK_SHIFT; cx <= x1 >> CHUNK_SHIFT; cx++) {
+			if ((chunkMaterials(cx, cy) & materials) == 0) {
+				continue;
+			}
+			// the part of the rectangle in this chunk, as columns and rows of its tile
+			const int left = std::max(x0 - cx * CHUNK_SIZE, 0);
+			const int right = std::min(x1 - cx * CHUNK_SIZE, CHUNK_SIZE - 1);
+			const uint32_t mask = ((right == CHUNK_SIZE - 1) ? ~0u : (1u << (right + 1)) - 1) & ~((1u << left) - 1);
+			const int bottom = std::max(y0 - cy * CHUNK_SIZE, 0);
+			const int top = std::min(y1 - cy * CHUNK_SIZE, CHUNK_SIZE - 1);
+			visitRows(tile(cx, cy), ~materials, bottom, top, rows);
+			if (f(rows, mask, bottom, top)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool CellGrid::any(const Rect& area, uint32_t materials)
+{
+	return forEachMaterialChunk(area, materials, [](const uint32_t* rows, uint32_t mask, int y0, int y1) {
+		for (int y = y0; y <= y1; y++) {
+			if (rows[y] & mask) {
+				return true;
+			}
+		}
+		return false;
+	});
+}
+
+int CellGrid::count(const Rect& area, uint32_t materials)
+{
+	int total = 0;
+	forEachMaterialChunk(area, materials, [&total](const uint32_t* rows, uint32_t mask, int y0, int y1) {
+		for (int y = y0; y <= y1; y++) {
+			total += bitCount(rows[y] & mask);
+		}
+		return false;
+	});
+	return total;
+}
+
+void CellGrid::clearOccupied()
+{
+	if (_occupied.allocated()) {
+		std::fill(_occupied.data(), _occupied.data() + (_storage >> CHUNK_SHIFT), 0u);
+	}
+}
+
+size_t CellGrid::memoryUsage() const
+{
+	size_t bytes = (_cells.size() + _next.size()) * sizeof(Material) + _parity.size();
+	bytes += _present.size() * sizeof(uint32_t) + _stale.size();
+	bytes += (_dirty.size() + _recent.size() + _older.size() + _active.size() + _changed.size()) * sizeof(Rect);
+	bytes += (_listed.size() + _listedNext.size()) * sizeof(uint16_t);
+	bytes += (_listedCount.size() + _listedNextCount.size()) * sizeof(int);
+	return bytes + _lifetime.bytes() + _temperature.bytes() + _wetness.bytes() + _occupied.bytes();
+}
+
+/// @brief FNV-1a over 8 bytes at a time
+static uint64_t hashBytes(uint64_t h, const void* data, size_t bytes)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	size_t i = 0;
+	for (; i + 8 <= bytes; i += 8) {
+		uint64_t word;
+		memcpy(&word, p + i, 8);
+		h = (h ^ word) * 0x100000001b3ull;
+	}
+	for (; i < bytes; i++) {
+		h = (h ^ p[i]) * 0x100000001b3ull;
+	}
+	return h;
+}
+
+uint64_t CellGrid::hash() const
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	h = hashBytes(h, &_width, sizeof(_width));
+	h = hashBytes(h, &_height, sizeof(_height));
+	h = hashBytes(h, _cells.data(), _cells.size());
+	h = hashBytes(h, _lifetime.data(), _lifetime.bytes());
+	h = hashBytes(h, _temperature.data(), _temperature.bytes());
+	h = hashBytes(h, _wetness.data(), _wetness.bytes());
+	return hashBytes(h, _occupied.data(), _occupied.bytes());
+}
+
+CellGrid::Rect CellGrid::grow(const Rect& r) const
+{
+	Rect g;
+	g.x0 = std::max(r.x0 - 1, 0);
+	g.y0 = std::max(r.y0 - 1, 0);
+	g.x1 = std::min(r.x1 + 1, _width - 1);
+	g.y1 = std::min(r.y1 + 1, _height - 1);
+	return g;
+}
+
+void CellGrid::wake(int x, int y, Rect* dirty)
+{
+	int lx = x % CHUNK_SIZE;
+	int ly = y % CHUNK_SIZE;
+	if (lx > 0 && lx < CHUNK_SIZE - 1 && ly > 0 && ly < CHUNK_SIZE - 1 && x < _width - 1 && y < _height - 1) {
+		// the neighbours are all in the same chunk
+		Rect& r = dirty[(y / CHUNK_SIZE) * _chunksX + x / CHUNK_SIZE];
+		if (r.empty()) {
+			r.x0 = x - 1;
+			r.y0 = y - 1;
+			r.x1 = x + 1;
+			r.y1 = y + 1;
+		}
+		else {
+			r.x0 = std::min(r.x0, x - 1);
+			r.y0 = std::min(r.y0, y - 1);
+			r.x1 = std::max(r.x1, x + 1);
+			r.y1 = std::max(r.y1, y + 1);
+		}
+		return;
+	}
+
+	// the cell and its neighbours, which may be in the next chunk over
+	Rect area;
+	area.x0 = std::max(x - 1, 0);
+	area.y0 = std::max(y - 1, 0);
+	area.x1 = std::min(x + 1, _width - 1);
+	area.y1 = std::min(y + 1, _height - 1);
+	wake(area, dirty);
+}
+
+void CellGrid::wake(const Rect& area, Rect* dirty)
+{
+	for (int cy = area.y0 / CHUNK_SIZE; cy <= area.y1 / CHUNK_SIZE; cy++) {
+		for (int cx = area.x0 / CHUNK_SIZE; cx <= area.x1 / CHUNK_SIZE; cx++) {
+			Rect part;
+			part.x0 = std::max(area.x0, cx * CHUNK_SIZE);
+			part.y0 = std::max(area.y0, cy * CHUNK_SIZE);
+			part.x1 = std::min(area.x1, cx * CHUNK_SIZE + CHUNK_SIZE - 1);
+			part.y1 = std::min(area.y1, cy * CHUNK_SIZE + CHUNK_SIZE - 1);
+			merge(dirty[cy * _chunksX + cx], part);
+		}
+	}
+}
+
+void CellGrid::list(int x, int y, Rect* dirty)
+{
+	int c = (y / CHUNK_SIZE) * _chunksX + x / CHUNK_SIZE;
+	uint16_t local = uint16_t((y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE);
+	int& count = _listedNextCount[c];
+	uint16_t* cells = &_listedNext[c * LIST_CAPACITY];
+	// a tick visits a cell once, so listing it twice is always in a row
+	if (count > 0 && cells[count - 1] == local) {
+		return;
+	}
+	if (count < LIST_CAPACITY) {
+		cells[count++] = local;
+		return;
+	}
+	wake(x, y, dirty);
+}
+
+void CellGrid::wakeAll()
+{
+	for (int cy = 0; cy < _chunksY; cy++) {
+		for (int cx = 0; cx < _chunksX; cx++) {
+			Rect& r = _dirty[cy * _chunksX + cx];
+			r.x0 = cx * CHUNK_SIZE;
+			r.y0 = cy * CHUNK_SIZE;
+			r.x1 = std::min(r.x0 + CHUNK_SIZE, _width) - 1;
+			r.y1 = std::min(r.y0 + CHUNK_SIZE, _height) - 1;
+		}
+	}
+	std::fill(_stale.begin(), _stale.end(), 1);
+}
+
+void CellGrid::clearDirty(std::vector<Rect>& dirty)
+{
+	dirty.assign(_dirty.size(), emptyRect);
+}
+
+void CellGrid::mergeDirty(std::vector<Rect>& dirty)
+{
+	for (size_t c = 0; c < dirty.size() && c < _dirty.size(); c++) {
+		if (!dirty[c].empty()) {
+			merge(_dirty[c], dirty[c]);
+			dirty[c] = emptyRect;
+			_stale[c] = 1; //a changed cell always wakes its own chunk
+		}
+	}
+}
+
+void CellGrid::beginChunks()
+{
+	// every SLEEP_TICKS ticks the recent changes become the older ones and the
+	// older ones are forgotten, so a change is visited for 4 to 8 ticks
+	bool age = (_ticks % SLEEP_TICKS) == 0;
+	_ticks++;
+
+	// the cells listed during the last tick are the ones this tick visits
+	_listed.swap(_listedNext);
+	_listedCount.swap(_listedNextCount);
+
+	_inTick = true;
+	_awakeChunks = 0;
+	for (size_t c = 0; c < _dirty.size(); c++) {
+		_listedNextCount[c] = 0;
+		if (age) {
+			_older[c] = _recent[c];
+			_recent[c] = emptyRect;
+		}
+		merge(_recent[c], _dirty[c]);
+		if (_trackChanges && !_dirty[c].empty()) {
+			if (_changed[c].empty()) {
+				_changedChunks.push_back(int(c));
+			}
+			merge(_changed[c], _dirty[c]);
+		}
+		_dirty[c] = emptyRect;
+
+		_active[c] = _recent[c];
+		merge(_active[c], _older[c]);
+		if (!_active[c].empty() || _listedCount[c] > 0) {
+			_awakeChunks++;
+		}
+	}
+}
+
+void CellGrid::trackChanges(bool track)
+{
+	_trackChanges = track;
+	clearChanges();
+}
+
+CellGrid::Rect CellGrid::changes(int cx, int cy) const
+{
+	// what was woken since the last tick is still in _dirty
+	int c = cy * _chunksX + cx;
+	Rect r = _changed[c];
+	merge(r, _dirty[c]);
+	return r;
+}
+
+void CellGrid::clearChanges()
+{
+	for (int c : _changedChunks) {
+		_changed[c] = emptyRect;
+	}
+	_changedChunks.clear();
+}
+
+void CellGrid::prepareBack(const Rect& r)
+{
+	Material* next = &_next[0];
+	const Material* cells = &_cells[0];
+	forEachRun(grow(r), [next, cells](int i, int x, int y, int count) {
+		memcpy(next + i, cells + i, count);
+	});
+}
+
+void CellGrid::commitBack(const Rect& r, Rect* dirty)
+{
+	forEachRun(grow(r), [this, dirty](int i, int x, int y, int count) {
+		if (memcmp(&_next[i], &_cells[i], count) == 0) {
+			return;
+		}
+		for (int n = 0; n < count; n++) {
+			if (_next[i + n] != _cells[i + n]) {
+				_cells[i + n] = _next[i + n];
+				wake(x + n, y, dirty);
+			}
+		}
+	});
+}
+
+void CellGrid::clearUpdated(const Rect& r)
+{
+	unsigned char* parity = &_parity[0];
+	unsigned char previous = _tick ^ 1;
+	forEachRun(r, [parity, previous](int i, int x, int y, int count) {
+		memset(parity + i, previous, count);
+	});
+}
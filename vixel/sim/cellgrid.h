@@ -0,0 +1,402 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef CELLGRID_H
+#define CELLGRID_H
+
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t Material; ///< @brief Material id of a cell, an index in Game::materials
+
+/// @brief One value of type T per cell, only allocated when a material needs it
+template<class T>
+class CellPlane
+{
+public:
+	bool allocated() const { return !_cells.empty(); } ///< @brief Check if a material uses this plane
+	T& operator[](size_t i) { return _cells[i]; } ///< @brief Value of a cell
+	T operator[](size_t i) const { return _cells[i]; } ///< @brief Value of a cell
+	T* data() { return _cells.data(); } ///< @brief All values, row by row
+	const T* data() const { return _cells.data(); } ///< @brief All values, row by row
+	size_t bytes() const { return _cells.size() * sizeof(T); } ///< @brief Memory used by the plane
+
+	/// @brief Allocate the plane (all zero), or clear it if it already is
+	/// @param size Number of cells
+	/// @return void
+	void allocate(size_t size) { _cells.assign(size, T()); }
+	/// @brief Free the plane
+	/// @return void
+	void release() { std::vector<T>().swap(_cells); }
+
+private:
+	std::vector<T> _cells; ///< @brief The values
+};
+
+/// @brief The material of every pixel in the level, with room to compute the next tick.
+///
+/// Materials are one byte per cell. Per-cell state that only some materials
+/// need (lifetime, temperature, wetness) lives in separate planes, so a tick
+/// that doesn't use them doesn't pay for them in memory or bandwidth.
+///
+/// The grid is split in chunks of CHUNK_SIZE x CHUNK_SIZE cells. Every change
+/// wakes the cell and its neighbours, the chunks collect that in a dirty
+/// rectangle, and a tick only visits the rectangles of the chunks that are
+/// awake. A chunk stays awake for SLEEP_TICKS to SLEEP_TICKS * 2 ticks after
+/// its last change, because some materials only move every 2nd or 4th tick.
+///
+/// Cells that didn't change but may on a later roll (a burning cell, water with
+/// room to flow) don't wake a rectangle. They go on a short list of their chunk
+/// for the next tick, and leave it as soon as they settle, so a few of them cost
+/// a few cell visits instead of keeping their surroundings awake. A chunk with
+/// more than LIST_CAPACITY of them wakes them like a change instead.
+///
+/// Cells are stored tile by tile: every chunk is one CHUNK_SIZE x CHUNK_SIZE
+/// block of memory, row by row inside the block. A tick visits a chunk column by
+/// column, and the block (1 KB of materials) stays in L1 while it does, however
+/// wide the grid is. The grid is padded to whole chunks. Use id(), cellX() and
+/// cellY() to go between positions and indices, never y * width + x.
+///
+/// Questions about a region (is any cell of this strip wood, how much air is
+/// there) go a chunk at a time: every chunk knows which materials are in it, so
+/// the ones without are skipped, and the others are turned into a bit per cell a
+/// row of 32 cells at a time by the row kernels, then masked and counted.
+///
+/// Both buffers are allocated once by resize(). A double-buffered tick copies
+/// the awake rectangles to the back buffer, writes its result there and copies
+/// it back, so a tick never allocates. An in-place tick only uses the front
+/// buffer and marks every cell it writes with the parity of the current tick,
+/// so a particle that moved ahead of the scan isn't processed twice.
+class CellGrid
+{
+public:
+	CellGrid(); ///< @brief Constructor of the CellGrid
+	virtual ~CellGrid(); ///< @brief Destructor of the CellGrid
+
+	static const int CHUNK_SHIFT = 5; ///< @brief log2 of CHUNK_SIZE
+	static const int CHUNK_SIZE = 1 << CHUNK_SHIFT; ///< @brief Width and height of a chunk (and a tile of memory) in cells
+	static const int CHUNK_MASK = CHUNK_SIZE - 1; ///< @brief Position inside a chunk
+	static const int SLEEP_TICKS = 4; ///< @brief Minimum number of quiet ticks before a chunk sleeps
+	static const int LIST_CAPACITY = 64; ///< @brief Maximum number of listed cells per chunk
+
+	/// @brief A rectangle of cells, inclusive. Empty when x0 > x1
+	struct Rect
+	{
+		int x0;
+		int y0;
+		int x1;
+		int y1;
+		bool empty() const { return x0 > x1; }
+		bool contains(int x, int y) const { return x >= x0 && x <= x1 && y >= y0 && y <= y1; }
+	};
+
+	/// @brief Set the size of the grid and clear it. Only allocates when the size changes
+	/// @param width Width
+	/// @param height Height
+	/// @return void
+	void resize(int width, int height);
+	/// @brief Copy a complete level into the front buffer
+	/// @param cells width * height materials, row by row
+	/// @return void
+	void assign(const std::vector<int>& cells);
+	/// @brief Copy a state saved from front() back into the front buffer and wake every cell
+	/// @param cells storage() materials, tile by tile
+	/// @return void
+	void load(const Material* cells);
+	/// @brief Move the grid over a bigger world by whole chunks: chunk (cx, cy) gets the cells,
+	/// metadata and dirty rectangles of chunk (cx + dcx, cy + dcy), the chunks that come
+	/// in are air until loadTile(). Not during a tick
+	/// @param dcx Chunks to the right
+	/// @param dcy Chunks up
+	/// @return void
+	void scroll(int dcx, int dcy);
+	/// @brief Copy the cells of one chunk in and wake it, and its neighbours along the edge
+	/// @param cx Chunk x
+	/// @param cy Chunk y
+	/// @param cells CHUNK_SIZE x CHUNK_SIZE materials, row by row, see tile()
+	/// @return void
+	void loadTile(int cx, int cy, const Material* cells);
+
+	/// @brief The metadata planes
+	enum Plane {
+		PLANE_LIFETIME, ///< @brief Ticks a cell has left (uint8_t)
+		PLANE_TEMPERATURE, ///< @brief Temperature of a cell (int16_t)
+		PLANE_WETNESS ///< @brief How wet a cell is (uint8_t)
+	};
+	/// @brief Allocate a metadata plane. Planes stay allocated (and are cleared) across resize()
+	/// @param plane Plane
+	/// @return void
+	void usePlane(Plane plane);
+	/// @brief Move the metadata of a cell along with its material. Only touches allocated planes
+	/// @param from Index of the cell the material moves out of
+	/// @param to Index of the cell it moves into
+	/// @return void
+	void moveMetadata(int from, int to);
+
+	/// @brief The materials in a chunk, bit m set when a cell of material m is in it.
+	/// Counted again the first time it's asked after a cell of the chunk changed. Between the slices
+	/// of a tick, counted every time for the chunks the tick can still change
+	/// @param cx Chunk x
+	/// @param cy Chunk y
+	/// @return uint32_t
+	uint32_t chunkMaterials(int cx, int cy);
+	/// @brief Which cells of a chunk are one of a set of materials, without the padding of the last chunks.
+	/// A chunk without any of them costs one look at chunkMaterials()
+	/// @param cx Chunk x
+	/// @param cy Chunk y
+	/// @param materials Bit m set: look for material m
+	/// @param rows CHUNK_SIZE masks out, bit x of rows[y] set when cell (x, y) of the chunk is one of them
+	/// @return bool false when none is
+	bool materialRows(int cx, int cy, uint32_t materials, uint32_t* rows);
+	/// @brief Check if any cell of a rectangle is one of a set of materials
+	/// @param area Rectangle, clipped to the grid
+	/// @param materials Bit m set: look for material m
+	/// @return bool
+	bool any(const Rect& area, uint32_t materials);
+	/// @brief Count the cells of a rectangle that are one of a set of materials
+	/// @param area Rectangle, clipped to the grid
+	/// @param materials Bit m set: count material m
+	/// @return int
+	int count(const Rect& area, uint32_t materials);
+
+	/// @brief Check if a character stands in a cell. Characters aren't cells: the World keeps
+	/// them in this plane, one bit per cell, and the simulation treats a cell with a
+	/// character in it as MAT_CHARACTER when it looks at its neighbours
+	inline bool occupied(int i) const {
+		return _occupied.allocated() && ((_occupied[size_t(i) >> CHUNK_SHIFT] >> (i & CHUNK_MASK)) & 1) != 0;
+	}
+	/// @brief Set or clear the occupied bits of a rectangle, allocates the plane the first time.
+	/// Doesn't touch the materials and doesn't wake anything. Not during a tick
+	/// @param area Rectangle, clipped to the grid
+	/// @param on Set or clear
+	/// @return void
+	void occupy(const Rect& area, bool on);
+	/// @brief Clear every occupied bit
+	/// @return void
+	void clearOccupied();
+
+	CellPlane<uint8_t>& lifetime() { return _lifetime; } ///< @brief Ticks a cell has left
+	CellPlane<int16_t>& temperature() { return _temperature; } ///< @brief Temperature of a cell
+	CellPlane<uint8_t>& wetness() { return _wetness; } ///< @brief How wet a cell is
+
+	/// @brief Memory used by the materials and all allocated planes
+	/// @return size_t bytes
+	size_t memoryUsage() const;
+	/// @brief Hash of the materials and all allocated planes, to check two runs ended in the same state
+	/// @return uint64_t
+	uint64_t hash() const;
+
+	int width() const { return _width; } ///< @brief Width of the grid
+	int height() const { return _height; } ///< @brief Height of the grid
+	size_t size() const { return _size; } ///< @brief Number of cells
+	size_t storage() const { return _storage; } ///< @brief Number of cells in memory, including the padding of the last chunks
+
+	/// @brief Index of the cell at (x, y), or -1 when it's outside the grid
+	inline int id(int x, int y) const {
+		if (x > -1 && x < _width && y > -1 && y < _height) {
+			return (((y >> CHUNK_SHIFT) * _chunksX + (x >> CHUNK_SHIFT)) << (2 * CHUNK_SHIFT)) | ((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK);
+		}
+		return -1;
+	}
+	/// @brief X of the cell at an index
+	inline int cellX(int i) const { return ((i >> (2 * CHUNK_SHIFT)) % _chunksX) * CHUNK_SIZE + (i & CHUNK_MASK); }
+	/// @brief Y of the cell at an index
+	inline int cellY(int i) const { return ((i >> (2 * CHUNK_SHIFT)) / _chunksX) * CHUNK_SIZE + ((i >> CHUNK_SHIFT) & CHUNK_MASK); }
+
+	Material operator[](size_t i) const { return _cells[i]; } ///< @brief Material of a cell
+	Material material(int i) const { return _cells[i]; } ///< @brief Material of a cell
+	/// @brief Set the material of a cell and wake it when it changes
+	inline void material(int i, Material m) {
+		if (_cells[i] != m) {
+			_cells[i] = m;
+			if (_keepEdits) {
+				_next[i] = m;
+			}
+			wake(cellX(i), cellY(i));
+		}
+	}
+	/// @brief Make material() write the back buffer too, while a double-buffered tick
+	/// is spread over several frames: the commit copies the back buffer over the
+	/// current state, that would undo what was set in between
+	/// @param keep Write both buffers
+	/// @return void
+	void keepEdits(bool keep) { _keepEdits = keep; }
+
+	Material* front() { return &_cells[0]; } ///< @brief The current state
+	const Material* front() const { return &_cells[0]; } ///< @brief The current state
+	Material* back() { return &_next[0]; } ///< @brief The next state, during a double-buffered tick
+	/// @brief The CHUNK_SIZE x CHUNK_SIZE block of the current state of a chunk, row by row
+	const Material* tile(int cx, int cy) const { return &_cells[size_t(cy * _chunksX + cx) << (2 * CHUNK_SHIFT)]; }
+
+	int chunksX() const { return _chunksX; } ///< @brief Number of chunks in a row
+	int chunksY() const { return _chunksY; } ///< @brief Number of chunks in a column
+	int chunkCount() const { return _chunksX * _chunksY; } ///< @brief Number of chunks
+	int awakeChunks() const { return _awakeChunks; } ///< @brief Number of chunks the current tick visits
+	/// @brief The cells of a chunk the current tick visits (empty when it sleeps)
+	const Rect& activeRect(int cx, int cy) const { return _active[cy * _chunksX + cx]; }
+	/// @brief Check if the current tick visits a chunk, for its active rectangle or its listed cells
+	bool awake(int cx, int cy) const {
+		int c = cy * _chunksX + cx;
+		return !_active[c].empty() || _listedCount[c] > 0;
+	}
+	/// @brief Number of listed cells the current tick visits in a chunk
+	int listedCount(int cx, int cy) const { return _listedCount[cy * _chunksX + cx]; }
+	/// @brief Index of a listed cell of a chunk
+	/// @param cx Chunk x
+	/// @param cy Chunk y
+	/// @param n Index in the list, smaller than listedCount()
+	/// @return int cell index
+	inline int listed(int cx, int cy, int n) const {
+		int c = cy * _chunksX + cx;
+		return (c << (2 * CHUNK_SHIFT)) + _listed[c * LIST_CAPACITY + n];
+	}
+	/// @brief A rectangle grown by one cell on every side, clipped to the grid
+	Rect grow(const Rect& r) const;
+
+	/// @brief Make the next tick visit this cell and its neighbours
+	/// @param x X
+	/// @param y Y
+	/// @return void
+	void wake(int x, int y) {
+		wake(x, y, &_dirty[0]);
+		_stale[(y >> CHUNK_SHIFT) * _chunksX + (x >> CHUNK_SHIFT)] = 1;
+	}
+	/// @brief Make the next tick visit this cell and its neighbours, collected in another set of dirty rectangles
+	/// @param x X
+	/// @param y Y
+	/// @param dirty One rectangle per chunk, see dirtyRects() and mergeDirty()
+	/// @return void
+	void wake(int x, int y, Rect* dirty);
+	/// @brief Make the next tick visit this cell only, it didn't change but may on a random roll.
+	/// Only the thread that runs the cell's chunk may list it
+	/// @param x X
+	/// @param y Y
+	/// @param dirty Where to wake the cell when the chunk's list is full, see wake()
+	/// @return void
+	void list(int x, int y, Rect* dirty);
+	/// @brief Make the next tick visit every cell of a rectangle
+	/// @param area Rectangle, inside the grid
+	/// @param dirty One rectangle per chunk, see wake()
+	/// @return void
+	void wake(const Rect& area, Rect* dirty);
+	/// @brief Make the next tick visit every cell
+	/// @return void
+	void wakeAll();
+	/// @brief The cells woken since the last tick, one rectangle per chunk
+	Rect* dirtyRects() { return &_dirty[0]; }
+	/// @brief Clear a set of dirty rectangles (one per chunk) for use with wake()
+	/// @param dirty One rectangle per chunk
+	/// @return void
+	void clearDirty(std::vector<Rect>& dirty);
+	/// @brief Add a set of dirty rectangles to the grid's own and clear it
+	/// @param dirty One rectangle per chunk, filled by wake()
+	/// @return void
+	void mergeDirty(std::vector<Rect>& dirty);
+	/// @brief Start a tick: turn the cells woken since the last tick into the active rectangles
+	/// @return void
+	void beginChunks();
+	/// @brief End a tick, after the dirty rectangles of the threads were merged or cleared
+	/// @return void
+	void endChunks() { _inTick = false; }
+
+	/// @brief Keep the woken cells for someone who looks less often than every tick
+	/// (the homes), see changes(). Off by default, costs a rectangle per woken chunk per tick
+	/// @param track Track or stop tracking, both forget what was tracked
+	/// @return void
+	void trackChanges(bool track);
+	/// @brief The cells of a chunk woken since the last clearChanges(), a superset of the ones
+	/// that changed. Only with trackChanges()
+	/// @param cx Chunk x
+	/// @param cy Chunk y
+	/// @return Rect empty when nothing did
+	Rect changes(int cx, int cy) const;
+	/// @brief Start tracking again from here
+	/// @return void
+	void clearChanges();
+
+	/// @brief Start a double-buffered tick for a rectangle: copy it (plus a one cell margin) to the back buffer
+	/// @param r Active rectangle
+	/// @return void
+	void prepareBack(const Rect& r);
+	/// @brief End a double-buffered tick for a rectangle: copy back what changed and wake it
+	/// @param r Active rectangle
+	/// @param dirty Where to collect the woken cells, see wake()
+	/// @return void
+	void commitBack(const Rect& r, Rect* dirty);
+
+	/// @brief Start an in-place tick: flips the parity, so no cell counts as updated
+	/// @return void
+	void beginTick() { _tick ^= 1; }
+	/// @brief Reset the parity of the cells an in-place tick is going to visit
+	/// @param r Active rectangle
+	/// @return void
+	void clearUpdated(const Rect& r);
+	/// @brief Check if an in-place tick already wrote this cell
+	inline bool updated(int i) const { return _parity[i] == _tick; }
+	/// @brief Mark a cell as written during this tick
+	inline void markUpdated(int i) { _parity[i] = _tick; }
+	/// @brief Reset the parity of one cell an in-place tick is going to visit
+	inline void clearUpdated(int i) { _parity[i] = _tick ^ 1; }
+
+private:
+	/// @brief Call f(rows, mask, y0, y1) for every chunk a rectangle crosses that has one of a set of materials:
+	/// the rows of the chunk that are (see materialRows()), the columns and the rows of the rectangle in it.
+	/// Stops when f returns true
+	/// @return bool true when f did
+	template<class F>
+	bool forEachMaterialChunk(const Rect& area, uint32_t materials, F f);
+	/// @brief Call f(index, x, y, count) for every run of cells of a rectangle that is contiguous in memory:
+	/// a row of the rectangle, split where it crosses into the next tile
+	template<class F>
+	void forEachRun(const Rect& r, F f) const {
+		for (int y = r.y0; y <= r.y1; y++) {
+			for (int x = r.x0; x <= r.x1; ) {
+				int end = std::min(r.x1, x | CHUNK_MASK);
+				f(id(x, y), x, y, end - x + 1);
+				x = end + 1;
+			}
+		}
+	}
+
+	int _width; ///< @brief Width of the grid
+	int _height; ///< @brief Height of the grid
+	size_t _size; ///< @brief Number of cells
+	size_t _storage; ///< @brief Number of cells in memory, whole chunks
+	std::vector<Material> _cells; ///< @brief The current state
+	std::vector<Material> _next; ///< @brief The next state, during a double-buffered tick
+	std::vector<unsigned char> _parity; ///< @brief Parity of the tick that last wrote each cell
+	std::vector<uint32_t> _present; ///< @brief The materials in every chunk, see chunkMaterials()
+	std::vector<uint8_t> _stale; ///< @brief A cell of the chunk changed since _present was counted
+	unsigned char _tick; ///< @brief Parity of the current tick
+	bool _keepEdits; ///< @brief material() writes the back buffer too, see keepEdits()
+	bool _inTick; ///< @brief Between beginChunks() and endChunks(), the threads keep what they change to themselves
+
+	int _chunksX; ///< @brief Number of chunks in a row
+	int _chunksY; ///< @brief Number of chunks in a column
+	int _awakeChunks; ///< @brief Number of chunks the current tick visits
+	unsigned int _ticks; ///< @brief Ticks since resize(), to age the dirty rectangles
+	std::vector<Rect> _dirty; ///< @brief Cells woken since the last tick, per chunk
+	std::vector<Rect> _recent; ///< @brief Cells woken during the last 0 to SLEEP_TICKS ticks
+	std::vector<Rect> _older; ///< @brief Cells woken during the SLEEP_TICKS ticks before that
+	std::vector<Rect> _active; ///< @brief Cells the current tick visits
+	std::vector<Rect> _changed; ///< @brief Cells woken since the last clearChanges(), before the last tick
+	std::vector<int> _changedChunks; ///< @brief Chunks with a rectangle in _changed
+	bool _trackChanges; ///< @brief beginChunks() keeps the woken cells in _changed
+	std::vector<uint16_t> _listed; ///< @brief Listed cells the current tick visits, LIST_CAPACITY per chunk, index in the chunk
+	std::vector<uint16_t> _listedNext; ///< @brief Cells listed for the next tick
+	std::vector<int> _listedCount; ///< @brief Number of listed cells per chunk, current tick
+	std::vector<int> _listedNextCount; ///< @brief Number of listed cells per chunk, next tick
+
+	CellPlane<uint8_t> _lifetime; ///< @brief Ticks a cell has left
+	CellPlane<int16_t> _temperature; ///< @brief Temperature of a cell
+	CellPlane<uint8_t> _wetness; ///< @brief How wet a cell is
+	CellPlane<uint32_t> _occupied; ///< @brief A bit per cell with a character in it, a word per row of a tile
+};
+
+#endif /* CELLGRID_H */
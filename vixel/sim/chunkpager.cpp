@@ -0,0 +1,434 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include "chunkpager.h"
+
+static const size_t TILE = CellGrid::CHUNK_SIZE * CellGrid::CHUNK_SIZE;
+
+/// @brief Append a number, 7 bits per byte
+static inline void putCount(std::vector<uint8_t>& out, size_t n)
+{
+	while (n >= 0x80) {
+		out.push_back(uint8_t(n | 0x80));
+		n >>= 7;
+	}
+	out.push_back(uint8_t(n));
+}
+
+/// @brief A chunk as runs of one material: (length, material) pairs
+static void compress(const Material* cells, std::vector<uint8_t>& out)
+{
+	out.clear();
+	size_t i = 0;
+	while (i < TILE) {
+		size_t run = 1;
+		while (i + run < TILE && cells[i + run] == cells[i]) {
+			run++;
+		}
+		putCount(out, run);
+		out.push_back(cells[i]);
+		i += run;
+	}
+}
+
+/// @brief Read a chunk written by compress()
+/// @return bool false when the data doesn't make a whole chunk
+static bool decompress(const std::vector<uint8_t>& in, Material* cells)
+{
+	size_t read = 0;
+	size_t i = 0;
+	while (i < TILE) {
+		size_t run = 0;
+		int shift = 0;
+		while (read < in.size() && (in[read] & 0x80)) {
+			run |= size_t(in[read++] & 0x7F) << shift;
+			shift += 7;
+		}
+		if (read + 2 > in.size()) {
+			return false;
+		}
+		run |= size_t(in[read++]) << shift;
+		if (run == 0 || i + run > TILE) {
+			return false;
+		}
+		memset(cells + i, in[read++], run);
+		i += run;
+	}
+	return true;
+}
+
+ChunkPager::ChunkPager()
+{
+	_worldX = 0;
+	_worldY = 0;
+	_windowX = 0;
+	_windowY = 0;
+	_originX = -1;
+	_originY = -1;
+	_fileEnd = 0;
+	_stop = false;
+	_pagedOut = 0;
+	_pagedIn = 0;
+	_stalls = 0;
+	_stallSeconds = 0.0;
+	_writeErrors = 0;
+}
+
+ChunkPager::~ChunkPager()
+{
+	close();
+}
+
+bool ChunkPager::open(const std::string& path, int worldWidth, int worldHeight, int windowWidth, int windowHeight)
+{
+	close();
+	const int size = CellGrid::CHUNK_SIZE;
+	_worldX = std::max((worldWidth + size - 1) / size, 1);
+	_worldY = std::max((worldHeight + size - 1) / size, 1);
+	_windowX = std::min(std::max((windowWidth + size - 1) / size, 1), _worldX);
+	_windowY = std::min(std::max((windowHeight + size - 1) / size, 1), _worldY);
+
+	_path = path;
+	_file.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!_file.is_open()) {
+		return false;
+	}
+	_fileEnd = 0;
+	_tile.resize(TILE);
+	_originX = -1;
+	_originY = -1;
+	_pagedOut = 0;
+	_pagedIn = 0;
+	_stalls = 0;
+	_stallSeconds = 0.0;
+	_writeErrors = 0;
+	_stop = false;
+	_thread = std::thread(&ChunkPager::run, this);
+	return true;
+}
+
+void ChunkPager::close()
+{
+	if (_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_work.notify_all();
+		_thread.join();
+	}
+	if (_file.is_open()) {
+		_file.close();
+		std::remove(_path.c_str());
+	}
+	_pages.clear();
+	_jobs.clear();
+	_cached.clear();
+	_originX = -1;
+	_originY = -1;
+}
+
+void ChunkPager::store(int wcx, int wcy, const Material* cells)
+{
+	if (!isOpen() || wcx < 0 || wcy < 0 || wcx >= _worldX || wcy >= _worldY) {
+		return;
+	}
+	std::unique_lock<std::mutex> lock(_mutex);
+	pageOut(lock, wcx, wcy, cells);
+}
+
+void ChunkPager::place(CellGrid& grid, int wcx, int wcy)
+{
+	if (!isOpen()) {
+		return;
+	}
+	wcx = std::max(0, std::min(wcx, _worldX - _windowX));
+	wcy = std::max(0, std::min(wcy, _worldY - _windowY));
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (_originX >= 0) {
+		for (int cy = 0; cy < _windowY; cy++) {
+			for (int cx = 0; cx < _windowX; cx++) {
+				pageOut(lock, _originX + cx, _originY + cy, grid.tile(cx, cy));
+				_pagedOut++;
+			}
+		}
+	}
+	lock.unlock();
+	grid.resize(_windowX * CellGrid::CHUNK_SIZE, _windowY * CellGrid::CHUNK_SIZE);
+	lock.lock();
+
+	// nothing is read ahead yet, waiting for these doesn't count as a stall
+	const int stalls = _stalls;
+	const double stallSeconds = _stallSeconds;
+	_originX = wcx;
+	_originY = wcy;
+	for (int cy = 0; cy < _windowY; cy++) {
+		for (int cx = 0; cx < _windowX; cx++) {
+			pageIn(lock, wcx + cx, wcy + cy, &_tile[0]);
+			grid.loadTile(cx, cy, &_tile[0]);
+		}
+	}
+	_stalls = stalls;
+	_stallSeconds = stallSeconds;
+	prefetch(lock);
+}
+
+bool ChunkPager::follow(CellGrid& grid, int x, int y, int& dcx, int& dcy)
+{
+	dcx = 0;
+	dcy = 0;
+	if (!isOpen() || _originX < 0) {
+		return false;
+	}
+	int ox = std::max(0, std::min(x / CellGrid::CHUNK_SIZE - _windowX / 2, _worldX - _windowX));
+	int oy = std::max(0, std::min(y / CellGrid::CHUNK_SIZE - _windowY / 2, _worldY - _windowY));
+	if (abs(ox - _originX) < SLACK && abs(oy - _originY) < SLACK) {
+		return false;
+	}
+	dcx = ox - _originX;
+	dcy = oy - _originY;
+
+	// the chunks that leave
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (int cy = 0; cy < _windowY; cy++) {
+		for (int cx = 0; cx < _windowX; cx++) {
+			int wx = _originX + cx;
+			int wy = _originY + cy;
+			if (wx < ox || wx >= ox + _windowX || wy < oy || wy >= oy + _windowY) {
+				pageOut(lock, wx, wy, grid.tile(cx, cy));
+				_pagedOut++;
+			}
+		}
+	}
+	lock.unlock();
+	grid.scroll(dcx, dcy);
+	lock.lock();
+
+	// the chunks that come in
+	const int oldX = _originX;
+	const int oldY = _originY;
+	_originX = ox;
+	_originY = oy;
+	for (int cy = 0; cy < _windowY; cy++) {
+		for (int cx = 0; cx < _windowX; cx++) {
+			int wx = ox + cx;
+			int wy = oy + cy;
+			if (wx < oldX || wx >= oldX + _windowX || wy < oldY || wy >= oldY + _windowY) {
+				pageIn(lock, wx, wy, &_tile[0]);
+				grid.loadTile(cx, cy, &_tile[0]);
+			}
+		}
+	}
+	prefetch(lock);
+	return true;
+}
+
+void ChunkPager::push(std::unique_lock<std::mutex>& lock, Job& job, bool urgent)
+{
+	_done.wait(lock, [this] { return _jobs.size() < size_t(MAX_JOBS); });
+	if (urgent) {
+		_jobs.push_front(job);
+	}
+	else {
+		_jobs.push_back(job);
+	}
+	_work.notify_one();
+}
+
+void ChunkPager::pageOut(std::unique_lock<std::mutex>& lock, int wcx, int wcy, const Material* cells)
+{
+	Page& p = _pages[key(wcx, wcy)];
+	p.version++;
+	p.state = PAGE_WRITING;
+	p.cells.assign(cells, cells + TILE);
+
+	Job job;
+	job.write = true;
+	job.key = key(wcx, wcy);
+	job.version = p.version;
+	push(lock, job, false);
+}
+
+void ChunkPager::pageIn(std::unique_lock<std::mutex>& lock, int wcx, int wcy, Material* cells)
+{
+	_pagedIn++;
+	auto it = _pages.find(key(wcx, wcy));
+	if (it == _pages.end()) {
+		// never stored: air
+		memset(cells, 0, TILE);
+		return;
+	}
+	Page& p = it->second;
+	if (p.state == PAGE_STORED) {
+		p.state = PAGE_READING;
+		Job job;
+		job.write = false;
+		job.key = it->first;
+		job.version = p.version;
+		push(lock, job, true);
+	}
+	if (p.state == PAGE_READING) {
+		// the camera outran the read ahead: read it next
+		for (size_t n = 1; n < _jobs.size(); n++) {
+			if (!_jobs[n].write && _jobs[n].key == it->first) {
+				Job job = _jobs[n];
+				_jobs.erase(_jobs.begin() + n);
+				_jobs.push_front(job);
+				break;
+			}
+		}
+		auto start = std::chrono::steady_clock::now();
+		_done.wait(lock, [&p] { return p.state != PAGE_READING; });
+		_stalls++;
+		_stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	memcpy(cells, &p.cells[0], TILE);
+	// a page that is still being written keeps its cells until it is
+	if (p.state == PAGE_READY) {
+		std::vector<Material>().swap(p.cells);
+		p.state = PAGE_STORED;
+	}
+}
+
+bool ChunkPager::nearWindow(int wcx, int wcy) const
+{
+	return wcx >= _originX - PREFETCH && wcx < _originX + _windowX + PREFETCH
+		&& wcy >= _originY - PREFETCH && wcy < _originY + _windowY + PREFETCH;
+}
+
+void ChunkPager::prefetch(std::unique_lock<std::mutex>& lock)
+{
+	// forget what was read ahead for where the window was
+	size_t kept = 0;
+	for (size_t n = 0; n < _cached.size(); n++) {
+		uint64_t k = _cached[n];
+		Page& p = _pages[k];
+		if (p.state == PAGE_READY && !nearWindow(int(uint32_t(k)), int(k >> 32))) {
+			std::vector<Material>().swap(p.cells);
+			p.state = PAGE_STORED;
+		}
+		if (p.state == PAGE_READY || p.state == PAGE_READING) {
+			_cached[kept++] = k;
+		}
+	}
+	_cached.resize(kept);
+
+	// read the ring around the window
+	const int x0 = std::max(_originX - PREFETCH, 0);
+	const int y0 = std::max(_originY - PREFETCH, 0);
+	const int x1 = std::min(_originX + _windowX + PREFETCH, _worldX);
+	const int y1 = std::min(_originY + _windowY + PREFETCH, _worldY);
+	for (int wy = y0; wy < y1; wy++) {
+		for (int wx = x0; wx < x1; wx++) {
+			if (wx >= _originX && wx < _originX + _windowX && wy >= _originY && wy < _originY + _windowY) {
+				continue;
+			}
+			auto it = _pages.find(key(wx, wy));
+			if (it == _pages.end() || it->second.state != PAGE_STORED) {
+				continue;
+			}
+			it->second.state = PAGE_READING;
+			_cached.push_back(it->first);
+			Job job;
+			job.write = false;
+			job.key = it->first;
+			job.version = it->second.version;
+			push(lock, job, false);
+		}
+	}
+}
+
+size_t ChunkPager::memoryUsage()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	size_t bytes = _pages.bucket_count() * sizeof(void*);
+	bytes += _pages.size() * (sizeof(Page) + sizeof(uint64_t) + 2 * sizeof(void*));
+	for (const auto& page : _pages) {
+		bytes += page.second.cells.capacity();
+	}
+	bytes += _jobs.size() * sizeof(Job) + _cached.capacity() * sizeof(uint64_t) + _tile.capacity();
+	return bytes;
+}
+
+size_t ChunkPager::fileBytes()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return size_t(_fileEnd);
+}
+
+void ChunkPager::run()
+{
+	std::vector<Material> cells(TILE);
+	std::vector<uint8_t> bytes;
+	bytes.reserve(2 * TILE);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_work.wait(lock, [this] { return _stop || !_jobs.empty(); });
+		if (_stop) {
+			break;
+		}
+		Job job = _jobs.front();
+		_jobs.pop_front();
+		Page& p = _pages[job.key];
+
+		if (job.write) {
+			// a newer version of the page is on its way, that one gets written
+			if (p.state == PAGE_WRITING && p.version == job.version) {
+				std::copy(p.cells.begin(), p.cells.end(), cells.begin());
+				lock.unlock();
+				compress(&cells[0], bytes);
+				// the page keeps its place in the file while it fits
+				lock.lock();
+				if (bytes.size() > p.capacity) {
+					p.offset = _fileEnd;
+					p.capacity = uint32_t(bytes.size());
+					_fileEnd += bytes.size();
+				}
+				uint64_t offset = p.offset;
+				lock.unlock();
+				_file.seekp(std::streamoff(offset));
+				_file.write((const char*)&bytes[0], bytes.size());
+				_file.flush();
+				bool written = bool(_file);
+				_file.clear();
+				lock.lock();
+				if (!written) {
+					// disk full or broken: the page keeps its cells, it isn't anywhere else
+					_writeErrors++;
+				}
+				else if (p.version == job.version) {
+					p.size = uint32_t(bytes.size());
+					std::vector<Material>().swap(p.cells);
+					p.state = PAGE_STORED;
+				}
+			}
+		}
+		else if (p.state == PAGE_READING) {
+			uint64_t offset = p.offset;
+			uint32_t size = p.size;
+			lock.unlock();
+			bytes.resize(size);
+			_file.seekg(std::streamoff(offset));
+			_file.read((char*)&bytes[0], size);
+			if (!_file || !decompress(bytes, &cells[0])) {
+				_file.clear();
+				memset(&cells[0], 0, TILE);
+			}
+			lock.lock();
+			p.cells.assign(cells.begin(), cells.end());
+			p.state = PAGE_READY;
+		}
+		_done.notify_all();
+	}
+}
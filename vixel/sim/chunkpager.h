@@ -0,0 +1,185 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef CHUNKPAGER_H
+#define CHUNKPAGER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include "cellgrid.h"
+
+/// @brief A world much bigger than the CellGrid: the grid is a window of chunks that
+/// follows the camera, the rest of the world waits in a page file.
+///
+/// Every chunk of the world that was ever stored has a Page in a hash map by chunk
+/// position, the others are air. A chunk that leaves the window is compressed
+/// (runs of one material) and written to the page file by a background thread.
+/// The same thread reads the chunks in a ring of PREFETCH chunks around the window
+/// before they come in, so follow() only waits for the disk when the camera moves
+/// faster than that. Memory is the window plus the pages on their way in or out,
+/// however big the world is.
+///
+/// The simulation only runs in the window, the rest of the world is frozen until
+/// it comes back in. Only the materials are paged, a chunk comes back without
+/// metadata (lifetime, temperature, wetness).
+class ChunkPager
+{
+public:
+	ChunkPager(); ///< @brief Constructor of the ChunkPager
+	virtual ~ChunkPager(); ///< @brief Destructor of the ChunkPager, stops the thread and removes the page file
+
+	static const int PREFETCH = 4; ///< @brief Width of the ring of chunks around the window that is read ahead
+	static const int SLACK = 2; ///< @brief Chunks the window lags behind the camera before it moves
+	static const int MAX_JOBS = 256; ///< @brief Pages waiting for the thread before store() and follow() wait for it
+
+	/// @brief Start a world: create the page file and the thread
+	/// @param path Page file, removed by close()
+	/// @param worldWidth Width of the world in cells, rounded up to whole chunks
+	/// @param worldHeight Height of the world in cells, rounded up to whole chunks
+	/// @param windowWidth Width of the window (the CellGrid) in cells, rounded up to whole chunks
+	/// @param windowHeight Height of the window in cells, rounded up to whole chunks
+	/// @return bool false when the page file can't be created
+	bool open(const std::string& path, int worldWidth, int worldHeight, int windowWidth, int windowHeight);
+	/// @brief Stop the thread, forget the world and remove the page file
+	/// @return void
+	void close();
+	/// @brief Check if a world is open
+	/// @return bool
+	bool isOpen() { return _file.is_open(); }
+
+	int worldChunksX() { return _worldX; } ///< @brief Width of the world in chunks
+	int worldChunksY() { return _worldY; } ///< @brief Height of the world in chunks
+	int originX() { return _originX; } ///< @brief World chunk x of grid chunk 0
+	int originY() { return _originY; } ///< @brief World chunk y of grid chunk 0
+
+	/// @brief Set the cells of a chunk of the world outside the window, to build a world with
+	/// @param wcx World chunk x
+	/// @param wcy World chunk y
+	/// @param cells CHUNK_SIZE x CHUNK_SIZE materials, row by row
+	/// @return void
+	void store(int wcx, int wcy, const Material* cells);
+	/// @brief Size the grid to the window and put the window at a chunk of the world, waits for all its chunks
+	/// @param grid The window
+	/// @param wcx World chunk x of the bottom left of the window
+	/// @param wcy World chunk y of the bottom left of the window
+	/// @return void
+	void place(CellGrid& grid, int wcx, int wcy);
+	/// @brief Keep a position of the world in the middle of the window: once it's more than SLACK chunks off,
+	/// page out the chunks that leave, scroll the grid and page in the chunks that come in. Not during a tick
+	/// @param grid The window
+	/// @param x World x in cells
+	/// @param y World y in cells
+	/// @param dcx Chunks the window moved to the right
+	/// @param dcy Chunks the window moved up
+	/// @return bool true when the window moved, positions in the grid moved by -dcx, -dcy chunks
+	bool follow(CellGrid& grid, int x, int y, int& dcx, int& dcy);
+
+	/// @brief Memory the pager holds: pages on their way in or out and the page table, not the grid
+	/// @return size_t bytes
+	size_t memoryUsage();
+	/// @brief Size of the page file
+	/// @return size_t bytes
+	size_t fileBytes();
+	int pagedOut() { return _pagedOut; } ///< @brief Chunks that left the window
+	int pagedIn() { return _pagedIn; } ///< @brief Chunks that came in
+	int stalls() { return _stalls; } ///< @brief Chunks follow() had to wait for
+	double stallSeconds() { return _stallSeconds; } ///< @brief Time follow() waited for the disk
+	int writeErrors() { std::lock_guard<std::mutex> lock(_mutex); return _writeErrors; } ///< @brief Pages the page file couldn't take, they stay in memory
+
+private:
+	/// @brief Where a page is
+	enum PageState {
+		PAGE_STORED, ///< @brief In the page file only
+		PAGE_WRITING, ///< @brief Waiting to be written, or the write failed, the cells are in memory
+		PAGE_READING, ///< @brief Waiting to be read
+		PAGE_READY ///< @brief In the page file and read ahead into memory
+	};
+	/// @brief A chunk of the world outside the window
+	struct Page
+	{
+		PageState state; ///< @brief Where it is
+		uint32_t version; ///< @brief Goes up every time the chunk is paged out, older writes are skipped
+		uint64_t offset; ///< @brief Where it is in the page file
+		uint32_t size; ///< @brief Compressed bytes in the page file
+		uint32_t capacity; ///< @brief Bytes the page owns in the page file, a smaller page reuses them
+		std::vector<Material> cells; ///< @brief The cells while they're written or after they're read, empty otherwise
+	};
+	/// @brief Work for the thread
+	struct Job
+	{
+		bool write; ///< @brief Write the page, or read it
+		uint64_t key; ///< @brief Chunk
+		uint32_t version; ///< @brief Version of the page to write
+	};
+
+	/// @brief Key of a chunk in the page table
+	static uint64_t key(int wcx, int wcy) { return (uint64_t(uint32_t(wcy)) << 32) | uint32_t(wcx); }
+	/// @brief Queue a job, waits while the queue is full. Call with the lock held
+	/// @param lock The lock of _mutex
+	/// @param job The job
+	/// @param urgent Before the other jobs, something waits for it
+	/// @return void
+	void push(std::unique_lock<std::mutex>& lock, Job& job, bool urgent);
+	/// @brief Send a chunk of the window to the page file
+	/// @param lock The lock of _mutex
+	/// @param wcx World chunk x
+	/// @param wcy World chunk y
+	/// @param cells CHUNK_SIZE x CHUNK_SIZE materials
+	/// @return void
+	void pageOut(std::unique_lock<std::mutex>& lock, int wcx, int wcy, const Material* cells);
+	/// @brief Get a chunk of the world for the window, waits when it isn't read yet
+	/// @param lock The lock of _mutex
+	/// @param wcx World chunk x
+	/// @param wcy World chunk y
+	/// @param cells CHUNK_SIZE x CHUNK_SIZE materials out
+	/// @return void
+	void pageIn(std::unique_lock<std::mutex>& lock, int wcx, int wcy, Material* cells);
+	/// @brief Read ahead the ring around the window, forget what was read ahead outside it
+	/// @param lock The lock of _mutex
+	/// @return void
+	void prefetch(std::unique_lock<std::mutex>& lock);
+	/// @brief Check if a world chunk is in the window or the ring around it
+	bool nearWindow(int wcx, int wcy) const;
+	/// @brief The thread: write and read pages until close()
+	/// @return void
+	void run();
+
+	int _worldX; ///< @brief Width of the world in chunks
+	int _worldY; ///< @brief Height of the world in chunks
+	int _windowX; ///< @brief Width of the window in chunks
+	int _windowY; ///< @brief Height of the window in chunks
+	int _originX; ///< @brief World chunk x of grid chunk 0, -1 before place()
+	int _originY; ///< @brief World chunk y of grid chunk 0
+	std::string _path; ///< @brief The page file
+	std::fstream _file; ///< @brief The page file, only the thread uses it after open()
+	uint64_t _fileEnd; ///< @brief Where the next new page goes in the page file
+
+	std::unordered_map<uint64_t, Page> _pages; ///< @brief The page table
+	std::vector<uint64_t> _cached; ///< @brief Pages that were read ahead
+	std::vector<Material> _tile; ///< @brief A chunk on its way between the grid and the pager
+	std::deque<Job> _jobs; ///< @brief Work for the thread
+	std::mutex _mutex; ///< @brief Guards the page table and the jobs
+	std::condition_variable _work; ///< @brief There's work for the thread
+	std::condition_variable _done; ///< @brief The thread finished a job
+	std::thread _thread; ///< @brief The background thread
+	bool _stop; ///< @brief The thread should stop
+
+	int _pagedOut; ///< @brief Chunks that left the window
+	int _pagedIn; ///< @brief Chunks that came in
+	int _stalls; ///< @brief Chunks follow() had to wait for
+	double _stallSeconds; ///< @brief Time follow() waited for the disk
+	int _writeErrors; ///< @brief Pages the page file couldn't take
+};
+
+#endif /* CHUNKPAGER_H */
@@ -0,0 +1,124 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include <cstring>
+#include "materials.h"
+
+static const MaterialRule defaultRules[] = {
+	// id                  name              behaviour           period  turnsInto  chance  flags
+	{ MAT_AIR,             "air",            BEHAVIOUR_STATIC,   1,      MAT_AIR,   0,      FLAG_CLEAR },
+	{ MAT_DIRT,            "dirt",           BEHAVIOUR_POWDER,   2,      MAT_GRASS, 50,     0 },
+	{ MAT_WOOD,            "wood",           BEHAVIOUR_STATIC,   1,      MAT_AIR,   0,      0 },
+	{ MAT_STONE,           "stone",          BEHAVIOUR_SLIDE,    1,      MAT_AIR,   90000,  0 },
+	{ MAT_FIRE,            "fire",           BEHAVIOUR_FIRE,     4,      MAT_AIR,   10,     0 },
+	{ MAT_LAVA,            "lava",           BEHAVIOUR_LIQUID,   2,      MAT_LAVA,  90000,  0 },
+	{ MAT_WATER,           "water",          BEHAVIOUR_LIQUID,   1,      MAT_AIR,   0,      0 },
+	{ MAT_ACID,            "acid",           BEHAVIOUR_DISSOLVE, 4,      MAT_AIR,   0,      0 },
+	{ MAT_CHARACTER,       "character",      BEHAVIOUR_STATIC,   1,      MAT_AIR,   0,      FLAG_CLEAR | FLAG_INDESTRUCTIBLE },
+	{ MAT_GRASS,           "grass",          BEHAVIOUR_GRASS,    2,      MAT_DIRT,  0,      0 },
+	{ MAT_HOME_INACTIVE,   "home_inactive",  BEHAVIOUR_STATIC,   1,      MAT_AIR,   0,      0 },
+	{ MAT_HOME_ACTIVE,     "home_active",    BEHAVIOUR_STATIC,   1,      MAT_AIR,   0,      0 },
+	{ MAT_DARK_STONE,      "dark_stone",     BEHAVIOUR_STATIC,   1,      MAT_AIR,   0,      0 },
+	{ MAT_INDESTRUCTIBLE,  "indestructible", BEHAVIOUR_STATIC,   1,      MAT_AIR,   0,      FLAG_INDESTRUCTIBLE }
+};
+
+static const Reaction defaultReactions[] = {
+	// falling and flowing
+	{ REACTION_MOVE,  MAT_DIRT,  MAT_AIR,   MAT_DIRT },
+	{ REACTION_MOVE,  MAT_DIRT,  MAT_WATER, MAT_DIRT },
+	{ REACTION_MOVE,  MAT_DIRT,  MAT_LAVA,  MAT_DIRT },
+	{ REACTION_MOVE,  MAT_GRASS, MAT_AIR,   MAT_DIRT },
+	{ REACTION_MOVE,  MAT_STONE, MAT_AIR,   MAT_STONE },
+	{ REACTION_MOVE,  MAT_STONE, MAT_WATER, MAT_STONE },
+	{ REACTION_MOVE,  MAT_WATER, MAT_AIR,   MAT_WATER },
+	{ REACTION_MOVE,  MAT_LAVA,  MAT_AIR,   MAT_LAVA },
+	// liquids meeting
+	{ REACTION_MOVE,  MAT_WATER, MAT_LAVA,  MAT_STONE },
+	{ REACTION_MOVE,  MAT_WATER, MAT_FIRE,  MAT_AIR },
+	{ REACTION_MOVE,  MAT_LAVA,  MAT_WOOD,  MAT_FIRE },
+	{ REACTION_MOVE,  MAT_LAVA,  MAT_WATER, MAT_STONE },
+	// spreading
+	{ REACTION_TOUCH, MAT_FIRE,  MAT_WOOD,  MAT_FIRE },
+	{ REACTION_TOUCH, MAT_ACID,  MaterialTable::MATERIAL_ANY, MAT_ACID }
+};
+
+MaterialTable::MaterialTable()
+{
+	compileDefaults();
+}
+
+MaterialTable::~MaterialTable()
+{
+
+}
+
+void MaterialTable::compileDefaults()
+{
+	compile(defaultRules, sizeof(defaultRules) / sizeof(defaultRules[0]),
+		defaultReactions, sizeof(defaultReactions) / sizeof(defaultReactions[0]));
+}
+
+bool MaterialTable::compile(const MaterialRule* rules, int ruleCount, const Reaction* reactions, int reactionCount)
+{
+	// every id starts as static air that nothing reacts with
+	for (int m = 0; m < MAX_MATERIALS; m++) {
+		MaterialRule& r = _rules[m];
+		r.id = Material(m);
+		r.name = "";
+		r.behaviour = BEHAVIOUR_STATIC;
+		r.period = 1;
+		r.turnsInto = MAT_AIR;
+		r.chance = 0;
+		r.flags = 0;
+		_odds[m] = 0;
+	}
+	memset(_moves, NONE, sizeof(_moves));
+	memset(_touches, NONE, sizeof(_touches));
+
+	for (int i = 0; i < ruleCount; i++) {
+		if (rules[i].id >= MAX_MATERIALS) {
+			compile(nullptr, 0, nullptr, 0);
+			return false;
+		}
+		_rules[rules[i].id] = rules[i];
+		if (_rules[rules[i].id].period < 1) {
+			_rules[rules[i].id].period = 1;
+		}
+		// a roll under 2^31 / chance is one in 'chance', no division per roll
+		int chance = _rules[rules[i].id].chance;
+		_odds[rules[i].id] = (chance > 0) ? 0x80000000u / uint32_t(chance) : 0;
+	}
+
+	for (int i = 0; i < reactionCount; i++) {
+		const Reaction& r = reactions[i];
+		if (r.actor >= MAX_MATERIALS || r.result >= MAX_MATERIALS || (r.target >= MAX_MATERIALS && r.target != MATERIAL_ANY)) {
+			compile(nullptr, 0, nullptr, 0);
+			return false;
+		}
+		Material (*table)[MAX_MATERIALS] = (r.kind == REACTION_MOVE) ? _moves : _touches;
+		if (r.target != MATERIAL_ANY) {
+			table[r.actor][r.target] = r.result;
+			continue;
+		}
+		for (int t = 0; t < MAX_MATERIALS; t++) {
+			if (t != MAT_AIR && t != r.actor && !is(t, FLAG_INDESTRUCTIBLE)) {
+				table[r.actor][t] = r.result;
+			}
+		}
+	}
+	return true;
+}
+
+unsigned int MaterialTable::behaviours(Behaviour* behaviours, int frameCount) const
+{
+	unsigned int active = 0;
+	for (int m = 0; m < MAX_MATERIALS; m++) {
+		behaviours[m] = (frameCount % _rules[m].period == 0) ? _rules[m].behaviour : BEHAVIOUR_STATIC;
+		active |= 1u << behaviours[m];
+	}
+	return active;
+}
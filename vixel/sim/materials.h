@@ -0,0 +1,126 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
+#include <stdint.h>
+#include "cellgrid.h"
+
+/// @brief The material ids, the same order as Game::materials
+enum MaterialId {
+	MAT_AIR = 0,
+	MAT_DIRT = 1,
+	MAT_WOOD = 2,
+	MAT_STONE = 3,
+	MAT_FIRE = 4,
+	MAT_LAVA = 5,
+	MAT_WATER = 6,
+	MAT_ACID = 7,
+	MAT_CHARACTER = 8, ///< @brief Never in the cells, what a cell with a character in it is to the simulation, see CellGrid::occupied()
+	MAT_GRASS = 9,
+	MAT_HOME_INACTIVE = 10,
+	MAT_HOME_ACTIVE = 11,
+	MAT_DARK_STONE = 12,
+	MAT_INDESTRUCTIBLE = 13
+};
+
+/// @brief How a material moves. Every material with the same behaviour runs the same code
+enum Behaviour {
+	BEHAVIOUR_STATIC, ///< @brief Never moves by itself
+	BEHAVIOUR_POWDER, ///< @brief Falls, and may turn into 'turnsInto' with air above
+	BEHAVIOUR_GRASS, ///< @brief Falls, and turns into 'turnsInto' when covered or falling
+	BEHAVIOUR_FIRE, ///< @brief Touches its neighbours, burns out one in 'chance' ticks
+	BEHAVIOUR_SLIDE, ///< @brief Falls when nothing holds it, slips one in 'chance' 4th ticks otherwise
+	BEHAVIOUR_LIQUID, ///< @brief Falls and flows sideways, may turn what it rests on into 'turnsInto'
+	BEHAVIOUR_DISSOLVE ///< @brief Touches its neighbours and disappears
+};
+
+/// @brief Material flags
+enum MaterialFlag {
+	FLAG_CLEAR = 1, ///< @brief Grass keeps growing under it
+	FLAG_INDESTRUCTIBLE = 2 ///< @brief Can't be touched by another material
+};
+
+/// @brief One row of the material table
+struct MaterialRule
+{
+	Material id; ///< @brief Material id
+	const char* name; ///< @brief Name, for debugging
+	Behaviour behaviour; ///< @brief How it moves
+	int period; ///< @brief Only moves every n-th tick
+	Material turnsInto; ///< @brief What it turns into, see Behaviour
+	int chance; ///< @brief One in n, see Behaviour. 0 never
+	int flags; ///< @brief MaterialFlag bits
+};
+
+/// @brief What a material does to another one
+enum ReactionKind {
+	REACTION_MOVE, ///< @brief The actor moves into the target, which becomes 'result'. The actor's cell becomes air
+	REACTION_TOUCH ///< @brief The target next to the actor becomes 'result'
+};
+
+/// @brief One pairwise reaction. A target of MATERIAL_ANY reacts with every destructible material but air and the actor
+struct Reaction
+{
+	ReactionKind kind; ///< @brief Move or touch
+	Material actor; ///< @brief The material that acts
+	Material target; ///< @brief What it acts on
+	Material result; ///< @brief What the target becomes
+};
+
+/// @brief The materials and their reactions, compiled into dense lookup tables.
+///
+/// The rules are declared as rows (see MaterialTable::defaults()) and compile()
+/// turns them into one behaviour per material and a move and touch table per
+/// pair of materials. The simulation dispatches on the behaviour and looks up
+/// the reactions, so a new material is a new row, not a new branch.
+class MaterialTable
+{
+public:
+	MaterialTable(); ///< @brief Constructor of the MaterialTable, compiles the default rules
+	virtual ~MaterialTable(); ///< @brief Destructor of the MaterialTable
+
+	static const int MAX_MATERIALS = 32; ///< @brief Material ids are smaller than this
+	static const Material NONE = 0xFF; ///< @brief No reaction
+	static const Material MATERIAL_ANY = 0xFE; ///< @brief Reaction target matching every material
+
+	/// @brief Build the lookup tables
+	/// @param rules The materials, any order
+	/// @param ruleCount Number of rules
+	/// @param reactions The reactions, later ones win
+	/// @param reactionCount Number of reactions
+	/// @return bool false if an id is MAX_MATERIALS or more, the table is left empty then
+	bool compile(const MaterialRule* rules, int ruleCount, const Reaction* reactions, int reactionCount);
+	/// @brief Build the lookup tables from the materials of the game
+	/// @return void
+	void compileDefaults();
+
+	/// @brief Behaviour of a material during a tick, BEHAVIOUR_STATIC when it skips the tick
+	/// @param behaviours MAX_MATERIALS entries to fill
+	/// @param frameCount Frames since the start of the game
+	/// @return unsigned int Bit b set: some material runs Behaviour b this tick
+	unsigned int behaviours(Behaviour* behaviours, int frameCount) const;
+
+	const MaterialRule& rule(int m) const { return _rules[m]; } ///< @brief The row of a material
+	/// @brief What 'target' becomes when 'actor' moves into it, NONE when it can't
+	inline Material moves(int actor, int target) const { return _moves[actor][target]; }
+	/// @brief What 'target' becomes when 'actor' touches it, NONE when nothing happens
+	inline Material touches(int actor, int target) const { return _touches[actor][target]; }
+	/// @brief Check for a flag
+	inline bool is(int m, MaterialFlag flag) const { return (_rules[m].flags & flag) != 0; }
+	/// @brief Check a random roll (0 to 2^31 - 1) against the one in 'chance' odds of a material
+	inline bool lucky(int m, int roll) const { return uint32_t(roll) < _odds[m]; }
+
+private:
+	MaterialRule _rules[MAX_MATERIALS]; ///< @brief One row per material id
+	Material _moves[MAX_MATERIALS][MAX_MATERIALS]; ///< @brief Move results
+	Material _touches[MAX_MATERIALS][MAX_MATERIALS]; ///< @brief Touch results
+	uint32_t _odds[MAX_MATERIALS]; ///< @brief 'chance' as a threshold for lucky(), 0 never
+};
+
+#endif /* MATERIALS_H */
@@ -0,0 +1,250 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include <cstring>
+#include "rowkernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define ROWKERNELS_X86
+	#include <emmintrin.h>
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define TARGET_AVX2
+	#else
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+static_assert(CellGrid::CHUNK_SIZE == 32, "the kernels work on 32 cell rows");
+
+static const int TILE = CellGrid::CHUNK_SIZE;
+
+static void visitMaskScalar(const Material* tile, uint32_t skip, uint32_t* rows, int count)
+{
+	for (int y = 0; y < count; y++) {
+		uint32_t mask = 0;
+		for (int x = 0; x < TILE; x++) {
+			Material m = tile[y * TILE + x];
+			if (m >= 32 || ((skip >> m) & 1) == 0) {
+				mask |= 1u << x;
+			}
+		}
+		rows[y] = mask;
+	}
+}
+
+static uint32_t tileMaterialsScalar(const Material* tile)
+{
+	// four at a time into four words, so they don't wait for each other
+	uint32_t present[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < TILE * TILE; i += 4) {
+		present[0] |= (tile[i] < 32) ? 1u << tile[i] : 0;
+		present[1] |= (tile[i + 1] < 32) ? 1u << tile[i + 1] : 0;
+		present[2] |= (tile[i + 2] < 32) ? 1u << tile[i + 2] : 0;
+		present[3] |= (tile[i + 3] < 32) ? 1u << tile[i + 3] : 0;
+	}
+	return present[0] | present[1] | present[2] | present[3];
+}
+
+#ifdef ROWKERNELS_X86
+
+static void visitMaskSSE2(const Material* tile, uint32_t skip, uint32_t* rows, int count)
+{
+	// one compare per skipped material, there are only a few
+	__m128i skipped[32];
+	int skips = 0;
+	for (int m = 0; m < 32; m++) {
+		if ((skip >> m) & 1) {
+			skipped[skips++] = _mm_set1_epi8(char(m));
+		}
+	}
+	for (int y = 0; y < count; y++) {
+		__m128i lo = _mm_loadu_si128((const __m128i*)(tile + y * TILE));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(tile + y * TILE + 16));
+		__m128i skipLo = _mm_setzero_si128();
+		__m128i skipHi = _mm_setzero_si128();
+		for (int i = 0; i < skips; i++) {
+			skipLo = _mm_or_si128(skipLo, _mm_cmpeq_epi8(lo, skipped[i]));
+			skipHi = _mm_or_si128(skipHi, _mm_cmpeq_epi8(hi, skipped[i]));
+		}
+		uint32_t mask = uint32_t(_mm_movemask_epi8(skipLo)) | (uint32_t(_mm_movemask_epi8(skipHi)) << 16);
+		rows[y] = ~mask;
+	}
+}
+
+TARGET_AVX2
+static void visitMaskAVX2(const Material* tile, uint32_t skip, uint32_t* rows, int count)
+{
+	// materials 0 to 15 through a table lookup, the rest (rare) with compares
+	alignas(32) char table[32];
+	for (int i = 0; i < 32; i++) {
+		table[i] = ((skip >> (i & 15)) & 1) ? char(0xFF) : 0;
+	}
+	const __m256i lookup = _mm256_load_si256((const __m256i*)table);
+	const __m256i fifteen = _mm256_set1_epi8(15);
+	__m256i skipped[16];
+	int skips = 0;
+	for (int m = 16; m < 32; m++) {
+		if ((skip >> m) & 1) {
+			skipped[skips++] = _mm256_set1_epi8(char(m));
+		}
+	}
+	for (int y = 0; y < count; y++) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(tile + y * TILE));
+		__m256i small = _mm256_cmpeq_epi8(_mm256_min_epu8(v, fifteen), v);
+		__m256i s = _mm256_and_si256(_mm256_shuffle_epi8(lookup, v), small);
+		for (int i = 0; i < skips; i++) {
+			s = _mm256_or_si256(s, _mm256_cmpeq_epi8(v, skipped[i]));
+		}
+		rows[y] = ~uint32_t(_mm256_movemask_epi8(s));
+	}
+}
+
+TARGET_AVX2
+static uint32_t tileMaterialsAVX2(const Material* tile)
+{
+	// a bit per material 0 to 7 and 8 to 15 through two table lookups, ORed over the
+	// whole tile, then the bytes ORed together. Anything bigger (rare) goes the slow way
+	const __m256i lowBits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+		1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i highBits = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128,
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+	const __m256i fifteen = _mm256_set1_epi8(15);
+	__m256i low = _mm256_setzero_si256();
+	__m256i high = _mm256_setzero_si256();
+	__m256i big = _mm256_setzero_si256();
+	for (int y = 0; y < TILE; y++) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(tile + y * TILE));
+		low = _mm256_or_si256(low, _mm256_shuffle_epi8(lowBits, v));
+		high = _mm256_or_si256(high, _mm256_shuffle_epi8(highBits, v));
+		big = _mm256_or_si256(big, _mm256_cmpgt_epi8(_mm256_max_epu8(v, fifteen), fifteen));
+	}
+	if (!_mm256_testz_si256(big, big)) {
+		return tileMaterialsScalar(tile);
+	}
+	alignas(32) uint8_t bytes[2][32];
+	_mm256_store_si256((__m256i*)bytes[0], low);
+	_mm256_store_si256((__m256i*)bytes[1], high);
+	uint32_t present = 0;
+	for (int i = 0; i < 32; i++) {
+		present |= bytes[0][i] | (uint32_t(bytes[1][i]) << 8);
+	}
+	return present;
+}
+
+static bool hasAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif
+
+typedef void (*VisitMask)(const Material* tile, uint32_t skip, uint32_t* rows, int count);
+typedef uint32_t (*TileMaterials)(const Material* tile);
+
+struct RowKernel
+{
+	VisitMask visitMask;
+	TileMaterials tileMaterials;
+	const char* name;
+};
+
+static RowKernel pickKernel()
+{
+	RowKernel k;
+#ifdef ROWKERNELS_X86
+	if (hasAVX2()) {
+		k.visitMask = visitMaskAVX2;
+		k.tileMaterials = tileMaterialsAVX2;
+		k.name = "avx2";
+		return k;
+	}
+	k.visitMask = visitMaskSSE2; // every x86-64 has it
+	k.tileMaterials = tileMaterialsScalar; // the table lookups need SSSE3
+	k.name = "sse2";
+#else
+	k.visitMask = visitMaskScalar;
+	k.tileMaterials = tileMaterialsScalar;
+	k.name = "scalar";
+#endif
+	return k;
+}
+
+static RowKernel kernel = pickKernel();
+
+void visitMask(const Material* tile, uint32_t skip, uint32_t* rows)
+{
+	kernel.visitMask(tile, skip, rows, TILE);
+}
+
+void visitRows(const Material* tile, uint32_t skip, int y0, int y1, uint32_t* rows)
+{
+	kernel.visitMask(tile + y0 * TILE, skip, rows + y0, y1 - y0 + 1);
+}
+
+uint32_t tileMaterials(const Material* tile)
+{
+	return kernel.tileMaterials(tile);
+}
+
+const char* rowKernelName()
+{
+	return kernel.name;
+}
+
+bool useRowKernel(const char* name)
+{
+	if (strcmp(name, "scalar") == 0) {
+		kernel.visitMask = visitMaskScalar;
+		kernel.tileMaterials = tileMaterialsScalar;
+		kernel.name = "scalar";
+		return true;
+	}
+#ifdef ROWKERNELS_X86
+	if (strcmp(name, "sse2") == 0) {
+		kernel.visitMask = visitMaskSSE2;
+		kernel.tileMaterials = tileMaterialsScalar;
+		kernel.name = "sse2";
+		return true;
+	}
+	if (strcmp(name, "avx2") == 0 && hasAVX2()) {
+		kernel.visitMask = visitMaskAVX2;
+		kernel.tileMaterials = tileMaterialsAVX2;
+		kernel.name = "avx2";
+		return true;
+	}
+#endif
+	return false;
+}
+
+void transposeMask(const uint32_t* rows, uint32_t* columns)
+{
+	for (int i = 0; i < TILE; i++) {
+		columns[i] = rows[i];
+	}
+	// swap the off-diagonal blocks of 16, then 8, ... then 1 bits
+	uint32_t m = 0x0000FFFFu;
+	for (int j = 16; j != 0; j >>= 1, m ^= m << j) {
+		for (int k = 0; k < TILE; k = ((k | j) + 1) & ~j) {
+			uint32_t t = ((columns[k] >> j) ^ columns[k | j]) & m;
+			columns[k] ^= t << j;
+			columns[k | j] ^= t;
+		}
+	}
+}
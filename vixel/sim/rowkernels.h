@@ -0,0 +1,83 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef ROWKERNELS_H
+#define ROWKERNELS_H
+
+#include <stdint.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include "cellgrid.h"
+
+// Bulk kernels over the rows of a tile (CellGrid::CHUNK_SIZE contiguous cells).
+//
+// A tick only has to run the rules for some cells: air never moves, and in an
+// in-place tick neither does a material that skips the tick. visitMask() finds
+// those cells 16 or 32 at a time, so the scan jumps from cell to cell that
+// matters instead of checking each one. The same masks answer questions about
+// regions of the grid (CellGrid::any(), count()). The kernel is picked once, on
+// first use: AVX2, SSE2 or plain C++, whatever the CPU runs.
+
+/// @brief Which cells of a tile need a visit
+/// @param tile CHUNK_SIZE x CHUNK_SIZE materials, row by row
+/// @param skip Bit m set: a cell of material m doesn't need a visit. Materials of 32 and up always do
+/// @param rows CHUNK_SIZE masks out, bit x of rows[y] set when cell (x, y) needs a visit
+/// @return void
+void visitMask(const Material* tile, uint32_t skip, uint32_t* rows);
+
+/// @brief visitMask() for some rows of a tile, for a question about a strip of it
+/// @param tile CHUNK_SIZE x CHUNK_SIZE materials, row by row
+/// @param skip Bit m set: a cell of material m doesn't count
+/// @param y0 First row
+/// @param y1 Last row
+/// @param rows CHUNK_SIZE masks, only y0 to y1 are written
+/// @return void
+void visitRows(const Material* tile, uint32_t skip, int y0, int y1, uint32_t* rows);
+
+/// @brief The materials in a tile
+/// @param tile CHUNK_SIZE x CHUNK_SIZE materials, row by row
+/// @return uint32_t bit m set when a cell of material m is in it, materials of 32 and up aren't
+uint32_t tileMaterials(const Material* tile);
+
+/// @brief Turn row masks into column masks: bit y of columns[x] is bit x of rows[y]
+/// @param rows CHUNK_SIZE masks
+/// @param columns CHUNK_SIZE masks out
+/// @return void
+void transposeMask(const uint32_t* rows, uint32_t* columns);
+
+/// @brief Name of the kernel visitMask() runs: "avx2", "sse2" or "scalar"
+/// @return const char*
+const char* rowKernelName();
+/// @brief Run another kernel than the one picked for this CPU, to compare them
+/// @param name "avx2", "sse2" or "scalar"
+/// @return bool false when the CPU can't run it
+bool useRowKernel(const char* name);
+
+/// @brief Index of the lowest set bit, the mask can't be 0
+inline int lowestBit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i, mask);
+	return int(i);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+/// @brief Number of set bits of a mask
+inline int bitCount(uint32_t mask)
+{
+#if defined(_MSC_VER)
+	return int(__popcnt(mask));
+#else
+	return __builtin_popcount(mask);
+#endif
+}
+
+#endif /* ROWKERNELS_H */
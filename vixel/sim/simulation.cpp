@@ -0,0 +1,662 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include <chrono>
+#include <algorithm>
+#include "simulation.h"
+#include "rowkernels.h"
+
+/// @brief Integer hash with good avalanche (lowbias32)
+static inline uint32_t mix(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+/// @brief Counter-based random roll: a pure function of the seed, the tick, the cell and
+/// which of the cell's rolls it is, so it doesn't matter which thread visits the cell or when
+static inline int roll(uint32_t seed, uint32_t tick, uint32_t cell, uint32_t draw)
+{
+	uint32_t h = mix(seed + draw * 0x9E3779B9u);
+	h = mix(h ^ tick);
+	h = mix(h ^ cell);
+	return int(h >> 1);
+}
+
+/// @brief Rules read the current state and write the back buffer, which starts as a copy of it
+struct DoubleBufferCells
+{
+	CellGrid* grid;
+	const Material* current;
+	Material* next;
+	CellGrid::Rect* dirty;
+	uint32_t seed;
+	uint32_t tick;
+
+	inline bool visit(int i) { return true; }
+	inline int get(int i) const { return current[i]; }
+	inline bool occupied(int i) const { return grid->occupied(i); }
+	/// @brief A cell the way a neighbour sees it: a character in it is in the way
+	inline int neighbour(int i) const { return occupied(i) ? int(MAT_CHARACTER) : current[i]; }
+	inline void set(int i, int mat) { next[i] = Material(mat); }
+	/// @brief Nothing moved in or out: carry the cell over, unless something moved into it
+	inline void keep(int i) {
+		if (next[i] == 0) {
+			next[i] = current[i];
+		}
+	}
+	/// @brief The cell didn't change, but a random roll may change it later
+	inline void keepAwake(int i) { grid->list(grid->cellX(i), grid->cellY(i), dirty); }
+	inline int random(int i, int draw) { return roll(seed, tick, i, draw); }
+};
+
+/// @brief Rules read and write the same buffer, every write is marked with the tick's parity
+struct InPlaceCells
+{
+	CellGrid* grid;
+	Material* cells;
+	CellGrid::Rect* dirty;
+	uint32_t seed;
+	uint32_t tick;
+
+	/// @brief Skip cells a particle already moved into this tick
+	inline bool visit(int i) {
+		if (grid->updated(i)) {
+			return false;
+		}
+		grid->markUpdated(i);
+		return true;
+	}
+	inline int get(int i) const { return cells[i]; }
+	inline bool occupied(int i) const { return grid->occupied(i); }
+	/// @brief A cell the way a neighbour sees it: a character in it is in the way
+	inline int neighbour(int i) const { return occupied(i) ? int(MAT_CHARACTER) : cells[i]; }
+	inline void set(int i, int mat) {
+		if (cells[i] != mat) {
+			cells[i] = Material(mat);
+			grid->wake(grid->cellX(i), grid->cellY(i), dirty);
+		}
+		grid->markUpdated(i);
+	}
+	inline void keep(int i) { }
+	/// @brief The cell didn't change, but a random roll may change it later
+	inline void keepAwake(int i) { grid->list(grid->cellX(i), grid->cellY(i), dirty); }
+	inline int random(int i, int draw) { return roll(seed, tick, i, draw); }
+};
+
+/// @brief The phases of a tick, each one runs in four checkerboard passes
+enum Phase { PHASE_CLEAR, PHASE_PREPARE, PHASE_STEP, PHASE_COMMIT };
+
+/// @brief A phase of a tick over the chunks of one checkerboard pass, 4 is all the awake chunks
+struct Stage
+{
+	Phase phase;
+	int pass;
+};
+
+/// @brief An in-place tick: every chunk only clears its own cells, they can all go at once
+static const Stage inPlaceStages[] = {
+	{ PHASE_CLEAR, 4 },
+	{ PHASE_STEP, 0 }, { PHASE_STEP, 1 }, { PHASE_STEP, 2 }, { PHASE_STEP, 3 }
+};
+
+/// @brief A double-buffered tick: the margins of neighbouring chunks overlap, so all phases go in passes
+static const Stage doubleBufferStages[] = {
+	{ PHASE_PREPARE, 0 }, { PHASE_PREPARE, 1 }, { PHASE_PREPARE, 2 }, { PHASE_PREPARE, 3 },
+	{ PHASE_STEP, 0 }, { PHASE_STEP, 1 }, { PHASE_STEP, 2 }, { PHASE_STEP, 3 },
+	{ PHASE_COMMIT, 0 }, { PHASE_COMMIT, 1 }, { PHASE_COMMIT, 2 }, { PHASE_COMMIT, 3 }
+};
+
+/// @brief Chunks per thread advance() runs between looking at the time
+static const int SLICE_CHUNKS = 4;
+/// @brief Part of its time advance() plans to use, the rest is for estimates that were too low
+static const double SLICE_PLANNED = 0.85;
+
+/// @brief Context of the worker pool jobs of a tick
+struct TickJobs
+{
+	Simulation* simulation;
+	CellGrid* grid;
+	int frameCount;
+	Phase phase;
+	const std::vector<int>* chunks;
+	int first;
+};
+
+Simulation::Simulation()
+{
+	_mode = MODE_DOUBLE_BUFFER;
+	_seed = 1;
+	_skip = 1u << MAT_AIR;
+	_rules = RULES_ALL;
+	_slips = true;
+	_ticking = false;
+	_frameCount = 0;
+	_stage = 0;
+	_cursor = 0;
+	for (int p = 0; p < 4; p++) {
+		_chunkSeconds[p] = 0.0;
+	}
+	_endSeconds = 0.0;
+	_workers.resize(1);
+}
+
+Simulation::~Simulation()
+{
+	_pool.stop();
+}
+
+void Simulation::threads(int n)
+{
+	if (n < 1) {
+		n = 1;
+	}
+	_pool.start(n);
+	_workers.resize(n);
+}
+
+void Simulation::step(CellGrid& grid, int frameCount)
+{
+	advance(grid, frameCount, -1.0);
+}
+
+bool Simulation::advance(CellGrid& grid, int frameCount, double seconds)
+{
+	auto start = std::chrono::steady_clock::now();
+	bool first = true;
+	if (!_ticking) {
+		if (grid.size() == 0) {
+			return true;
+		}
+		beginTick(grid, frameCount);
+		first = false; // starting the tick is progress too
+	}
+	const Stage* stages = (_mode == MODE_IN_PLACE) ? inPlaceStages : doubleBufferStages;
+	const int stageCount = (_mode == MODE_IN_PLACE) ? 5 : 12;
+	const int batch = (seconds < 0) ? grid.chunkCount() : SLICE_CHUNKS * _pool.threads();
+	const double planned = seconds * SLICE_PLANNED;
+
+	TickJobs tick;
+	tick.simulation = this;
+	tick.grid = &grid;
+	tick.frameCount = _frameCount;
+
+	while (_stage < stageCount) {
+		const Stage& stage = stages[_stage];
+		const std::vector<int>& chunks = (stage.pass < 4) ? _passes[stage.pass] : _awake;
+		const int left = (int)chunks.size() - _cursor;
+		if (left <= 0) {
+			_stage++;
+			_cursor = 0;
+			continue;
+		}
+		int count = std::min(left, batch);
+		// only as many chunks as probably fit in the time that's left
+		std::chrono::steady_clock::time_point batchStart;
+		if (seconds >= 0) {
+			batchStart = std::chrono::steady_clock::now();
+			double remaining = planned - std::chrono::duration<double>(batchStart - start).count();
+			double chunk = _chunkSeconds[stage.phase];
+			if (chunk > 0 && count * chunk > remaining) {
+				count = std::max(0, int(remaining / chunk));
+				if (count == 0 && first) {
+					count = 1;
+				}
+			}
+			if (count == 0) {
+				// the commit copies the back buffer over the grid, keep what is set until then
+				grid.keepEdits(_mode == MODE_DOUBLE_BUFFER);
+				return false;
+			}
+		}
+		tick.phase = stage.phase;
+		tick.chunks = &chunks;
+		tick.first = _cursor;
+		_pool.run(chunkJob, &tick, count);
+		_cursor += count;
+		first = false;
+		if (seconds >= 0) {
+			double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+			_chunkSeconds[stage.phase] = estimate(_chunkSeconds[stage.phase], took / count);
+		}
+	}
+	// merging the dirty rectangles of the workers takes time too, leave it for the next call when it doesn't fit
+	if (seconds >= 0) {
+		auto endStart = std::chrono::steady_clock::now();
+		if (!first && std::chrono::duration<double>(endStart - start).count() + _endSeconds > planned) {
+			grid.keepEdits(_mode == MODE_DOUBLE_BUFFER);
+			return false;
+		}
+		endTick(grid);
+		_endSeconds = estimate(_endSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - endStart).count());
+		return true;
+	}
+	endTick(grid);
+	return true;
+}
+
+double Simulation::estimate(double previous, double measured)
+{
+	// up at once, down slowly: one slow batch keeps the next ones small for a while
+	return std::max(measured, previous * 0.75);
+}
+
+void Simulation::cancel(CellGrid& grid)
+{
+	if (!_ticking) {
+		return;
+	}
+	for (Worker& w : _workers) {
+		grid.clearDirty(w.dirty);
+	}
+	// the grid is loaded or resized next, that counts every chunk again
+	grid.endChunks();
+	grid.keepEdits(false);
+	_ticking = false;
+}
+
+void Simulation::beginTick(CellGrid& grid, int frameCount)
+{
+	grid.beginChunks();
+
+	const int chunksX = grid.chunksX();
+	const int chunksY = grid.chunksY();
+
+	// sort the awake chunks in passes: chunks of one pass are a chunk apart.
+	// One thread runs the same passes in the same order, so the result
+	// doesn't depend on the number of threads
+	if (_awake.capacity() < size_t(grid.chunkCount())) {
+		_awake.reserve(grid.chunkCount());
+		for (int p = 0; p < 4; p++) {
+			_passes[p].reserve(grid.chunkCount());
+		}
+	}
+	_awake.clear();
+	for (int p = 0; p < 4; p++) {
+		_passes[p].clear();
+	}
+	for (int cx = 0; cx < chunksX; cx++) {
+		for (int cy = 0; cy < chunksY; cy++) {
+			if (grid.awake(cx, cy)) {
+				int c = cy * chunksX + cx;
+				_awake.push_back(c);
+				_passes[(cx & 1) + 2 * (cy & 1)].push_back(c);
+			}
+		}
+	}
+	for (Worker& w : _workers) {
+		if (w.dirty.size() != size_t(grid.chunkCount())) {
+			grid.clearDirty(w.dirty);
+		}
+	}
+
+	// what moves this tick, the smallest version of the rules that covers it
+	// runs every cell, so the rules themselves never look at the tick
+	unsigned int active = _materials.behaviours(_behaviours, frameCount);
+	if ((active & ~unsigned(RULES_FLOW | (1 << BEHAVIOUR_STATIC))) == 0) {
+		_rules = RULES_FLOW;
+	}
+	else if ((active & ~unsigned(RULES_FALL | (1 << BEHAVIOUR_STATIC))) == 0) {
+		_rules = RULES_FALL;
+	}
+	else {
+		_rules = RULES_ALL;
+	}
+	_slips = (frameCount & 3) == 0;
+
+	// cells the scan can jump over: air never does anything. An in-place tick
+	// can also skip what keeps still this tick, a double-buffered one has to
+	// carry those over to the back buffer
+	_skip = 1u << MAT_AIR;
+	if (_mode == MODE_IN_PLACE) {
+		for (int m = 0; m < MaterialTable::MAX_MATERIALS; m++) {
+			if (_behaviours[m] == BEHAVIOUR_STATIC) {
+				_skip |= 1u << m;
+			}
+		}
+		grid.beginTick();
+	}
+
+	_ticking = true;
+	_frameCount = frameCount;
+	_stage = 0;
+	_cursor = 0;
+}
+
+void Simulation::endTick(CellGrid& grid)
+{
+	for (Worker& w : _workers) {
+		grid.mergeDirty(w.dirty);
+	}
+	grid.endChunks();
+	grid.keepEdits(false);
+	_ticking = false;
+}
+
+void Simulation::chunkJob(void* context, int index, int worker)
+{
+	TickJobs& tick = *(TickJobs*)context;
+	CellGrid& grid = *tick.grid;
+	Simulation& simulation = *tick.simulation;
+	Worker& w = simulation._workers[worker];
+
+	int c = (*tick.chunks)[tick.first + index];
+	const int cx = c % grid.chunksX();
+	const int cy = c / grid.chunksX();
+	const CellGrid::Rect& r = grid.activeRect(cx, cy);
+	const int listed = grid.listedCount(cx, cy);
+
+	switch (tick.phase) {
+		case PHASE_CLEAR:
+			if (!r.empty()) {
+				grid.clearUpdated(r);
+			}
+			for (int n = 0; n < listed; n++) {
+				grid.clearUpdated(grid.listed(cx, cy, n));
+			}
+			break;
+		case PHASE_PREPARE:
+			if (!r.empty()) {
+				grid.prepareBack(r);
+			}
+			for (int n = 0; n < listed; n++) {
+				int i = grid.listed(cx, cy, n);
+				int x = grid.cellX(i);
+				int y = grid.cellY(i);
+				CellGrid::Rect cell = { x, y, x, y };
+				if (!r.contains(x, y)) {
+					grid.prepareBack(cell);
+				}
+			}
+			break;
+		case PHASE_STEP:
+			if (simulation._mode == MODE_IN_PLACE) {
+				InPlaceCells cells;
+				cells.grid = &grid;
+				cells.cells = grid.front();
+				cells.dirty = &w.dirty[0];
+				cells.seed = simulation._seed;
+				cells.tick = uint32_t(tick.frameCount);
+				simulation.runChunk(grid, cells, cx, cy);
+			}
+			else {
+				DoubleBufferCells cells;
+				cells.grid = &grid;
+				cells.current = grid.front();
+				cells.next = grid.back();
+				cells.dirty = &w.dirty[0];
+				cells.seed = simulation._seed;
+				cells.tick = uint32_t(tick.frameCount);
+				simulation.runChunk(grid, cells, cx, cy);
+			}
+			break;
+		case PHASE_COMMIT:
+			if (!r.empty()) {
+				grid.commitBack(r, &w.dirty[0]);
+			}
+			for (int n = 0; n < listed; n++) {
+				int i = grid.listed(cx, cy, n);
+				int x = grid.cellX(i);
+				int y = grid.cellY(i);
+				CellGrid::Rect cell = { x, y, x, y };
+				if (!r.contains(x, y)) {
+					grid.commitBack(cell, &w.dirty[0]);
+				}
+			}
+			break;
+	}
+}
+
+/// @brief Move a material into a neighbour if the table allows it, leaving air behind
+template<class Cells>
+static inline bool moveInto(Cells& cells, const MaterialTable& table, int mat, int from, int to)
+{
+	if (to < 0) {
+		return false;
+	}
+	Material result = table.moves(mat, cells.neighbour(to));
+	if (result == MaterialTable::NONE) {
+		return false;
+	}
+	cells.set(from, MAT_AIR);
+	cells.set(to, result);
+	return true;
+}
+
+/// @brief Let a material act on a neighbour if the table says it does
+template<class Cells>
+static inline void touch(Cells& cells, const MaterialTable& table, int mat, int to)
+{
+	if (to < 0) {
+		return;
+	}
+	Material result = table.touches(mat, cells.neighbour(to));
+	if (result != MaterialTable::NONE) {
+		cells.set(to, result);
+	}
+}
+
+/// @brief Check if a material could move into a neighbour
+template<class Cells>
+static inline bool canMoveInto(Cells& cells, const MaterialTable& table, int mat, int to)
+{
+	return to > -1 && table.moves(mat, cells.neighbour(to)) != MaterialTable::NONE;
+}
+
+template<class Cells>
+void Simulation::runChunk(CellGrid& grid, Cells& cells, int cx, int cy)
+{
+	switch (_rules) {
+		case RULES_FLOW:
+			stepChunk<RULES_FLOW>(grid, cells, cx, cy);
+			break;
+		case RULES_FALL:
+			stepChunk<RULES_FALL>(grid, cells, cx, cy);
+			break;
+		case RULES_ALL:
+			stepChunk<RULES_ALL>(grid, cells, cx, cy);
+			break;
+	}
+}
+
+template<unsigned int RULES, class Cells>
+void Simulation::stepChunk(CellGrid& grid, Cells& cells, int cx, int cy)
+{
+	const CellGrid::Rect& r = grid.activeRect(cx, cy);
+	if (!r.empty()) {
+		// find the cells that need the rules 32 at a time, then visit them
+		// column by column, bottom to top, like a scan over every cell would
+		uint32_t rows[CellGrid::CHUNK_SIZE];
+		uint32_t columns[CellGrid::CHUNK_SIZE];
+		visitMask(grid.tile(cx, cy), _skip, rows);
+		transposeMask(rows, columns);
+
+		const int top = cy * CellGrid::CHUNK_SIZE;
+		const int y0 = r.y0 - top;
+		const int y1 = r.y1 - top;
+		const uint32_t span = (y1 == CellGrid::CHUNK_SIZE - 1 ? ~0u : (1u << (y1 + 1)) - 1) & ~((1u << y0) - 1);
+		for (int x = r.x0; x <= r.x1; x++) {
+			uint32_t bits = columns[x & CellGrid::CHUNK_MASK] & span;
+			while (bits != 0) {
+				int y = top + lowestBit(bits);
+				bits &= bits - 1;
+				if (cells.visit(grid.id(x, y))) {
+					stepCell<RULES>(grid, cells, x, y);
+				}
+			}
+		}
+	}
+
+	// the listed cells after the rectangle, in the order they were listed
+	const int listed = grid.listedCount(cx, cy);
+	for (int n = 0; n < listed; n++) {
+		int pixel = grid.listed(cx, cy, n);
+		int x = grid.cellX(pixel);
+		int y = grid.cellY(pixel);
+		int mat = cells.get(pixel);
+		if (_behaviours[mat] == BEHAVIOUR_STATIC) {
+			// the material skips this tick, stay listed until it doesn't
+			if (_materials.rule(mat).behaviour != BEHAVIOUR_STATIC) {
+				cells.keepAwake(pixel);
+			}
+			continue;
+		}
+		if (!r.contains(x, y) && cells.visit(pixel)) {
+			stepCell<RULES>(grid, cells, x, y);
+		}
+	}
+}
+
+/// @brief Check if a version of the rules runs a behaviour, known at compile time
+template<unsigned int RULES>
+static inline bool runs(Behaviour b)
+{
+	return ((RULES >> b) & 1) != 0;
+}
+
+template<unsigned int RULES, class Cells>
+inline void Simulation::stepCell(CellGrid& grid, Cells& cells, int x, int y)
+{
+	const MaterialTable& table = _materials;
+
+	int pixel = grid.id(x, y);
+	int pixelAbove = grid.id(x, y + 1);
+	int pixelBelow = grid.id(x, y - 1);
+	int pixelLeft = grid.id(x - 1, y);
+	int pixelRight = grid.id(x + 1, y);
+
+	const int mat = cells.get(pixel);
+	const MaterialRule& rule = table.rule(mat);
+
+	// a behaviour this version doesn't run can't come up this tick, it
+	// compiles to an empty case
+	switch (_behaviours[mat]) {
+
+		//falls, grows grass when it rests on itself with air above
+		case BEHAVIOUR_POWDER:
+			if (!runs<RULES>(BEHAVIOUR_POWDER)) {
+				break;
+			}
+			if (moveInto(cells, table, mat, pixel, pixelBelow)) {
+				break;
+			}
+			if (rule.chance > 0 && (pixelBelow == -1 || cells.neighbour(pixelBelow) == mat) && pixelAbove != -1 && cells.neighbour(pixelAbove) == MAT_AIR) {
+				cells.keepAwake(pixel);
+				if (table.lucky(mat, cells.random(pixel, 0))) {
+					cells.set(pixel, rule.turnsInto);
+					break;
+				}
+			}
+			cells.set(pixel, mat);
+			break;
+
+		//falls, and dies when something covers it
+		case BEHAVIOUR_GRASS:
+			if (!runs<RULES>(BEHAVIOUR_GRASS)) {
+				break;
+			}
+			if (moveInto(cells, table, mat, pixel, pixelBelow)) {
+				break;
+			}
+			if (pixelAbove == -1 || !table.is(cells.neighbour(pixelAbove), FLAG_CLEAR)) {
+				cells.set(pixel, rule.turnsInto);
+			}
+			else {
+				cells.set(pixel, mat);
+			}
+			break;
+
+		//spreads to its neighbours and burns out
+		case BEHAVIOUR_FIRE:
+			if (!runs<RULES>(BEHAVIOUR_FIRE)) {
+				break;
+			}
+			touch(cells, table, mat, pixelAbove);
+			touch(cells, table, mat, pixelBelow);
+			touch(cells, table, mat, pixelLeft);
+			touch(cells, table, mat, pixelRight);
+			if (table.lucky(mat, cells.random(pixel, 0))) {
+				cells.set(pixel, rule.turnsInto);
+			}
+			else {
+				cells.set(pixel, mat);
+				cells.keepAwake(pixel); //burns out eventually
+			}
+			break;
+
+		//falls when nothing holds it on the sides, slips down eventually otherwise
+		case BEHAVIOUR_SLIDE:
+			if (!runs<RULES>(BEHAVIOUR_SLIDE)) {
+				break;
+			}
+			if (canMoveInto(cells, table, mat, pixelBelow)) {
+				if (pixelLeft > -1 && cells.neighbour(pixelLeft) == MAT_AIR && pixelRight > -1 && cells.neighbour(pixelRight) == MAT_AIR) {
+					moveInto(cells, table, mat, pixel, pixelBelow);
+					break;
+				}
+				cells.keepAwake(pixel);
+				if (_slips && table.lucky(mat, cells.random(pixel, 0))) {
+					moveInto(cells, table, mat, pixel, pixelBelow);
+					break;
+				}
+			}
+			cells.set(pixel, mat);
+			break;
+
+		//falls and flows to a random side
+		case BEHAVIOUR_LIQUID: {
+			if (!runs<RULES>(BEHAVIOUR_LIQUID)) {
+				break;
+			}
+			int dir = int((uint64_t(cells.random(pixel, 0)) * 3) >> 31); //0, 1 or 2 without a division
+			bool moved = false;
+			if (dir == 1) {
+				moved = moveInto(cells, table, mat, pixel, pixelLeft);
+			}
+			else if (dir == 2) {
+				moved = moveInto(cells, table, mat, pixel, pixelRight);
+			}
+			if (moveInto(cells, table, mat, pixel, pixelBelow)) {
+				moved = true;
+			}
+			if (!moved) { //keep the pixel the same place as before
+				cells.set(pixel, mat);
+				//it may still go sideways on another roll
+				if (canMoveInto(cells, table, mat, pixelLeft) || canMoveInto(cells, table, mat, pixelRight)) {
+					cells.keepAwake(pixel);
+				}
+			}
+			if (rule.chance > 0 && pixelBelow > -1 && cells.get(pixelBelow) != MAT_AIR && !cells.occupied(pixelBelow)) { //can melt what it rests on, not a character
+				cells.keepAwake(pixel);
+				if (table.lucky(mat, cells.random(pixel, 1))) {
+					cells.set(pixelBelow, rule.turnsInto);
+				}
+			}
+			break;
+		}
+
+		//moves into what it eats, or evaporates when there's nothing
+		case BEHAVIOUR_DISSOLVE:
+			if (!runs<RULES>(BEHAVIOUR_DISSOLVE)) {
+				break;
+			}
+			cells.set(pixel, rule.turnsInto);
+			touch(cells, table, mat, pixelAbove);
+			touch(cells, table, mat, pixelBelow);
+			touch(cells, table, mat, pixelLeft);
+			touch(cells, table, mat, pixelRight);
+			break;
+
+		case BEHAVIOUR_STATIC:
+			cells.keep(pixel);
+			break;
+	}
+}
@@ -0,0 +1,178 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <vector>
+#include "cellgrid.h"
+#include "materials.h"
+#include "workerpool.h"
+
+/// @brief The falling sand rules: moves and transforms the materials in a CellGrid.
+///
+/// What the materials do is declared in a MaterialTable. A cell dispatches on the
+/// behaviour of its material and looks its reactions up, so materials that behave
+/// alike share one code path.
+///
+/// Doesn't know about canvases or characters, so it can run headless (vixel_bench).
+/// With more than one thread, the awake chunks are split in four checkerboard
+/// passes. A rule only reaches one cell outside its chunk, so the chunks of one
+/// pass never touch each other's cells and run on the worker pool in parallel.
+/// One thread runs the same passes in the same order, and every random roll is
+/// a hash of the seed, the tick and the cell, so a tick gives the same result
+/// on any number of threads. CellGrid::hash() checks that.
+///
+/// Which materials move depends on the tick, but not per cell: step() looks it
+/// up once and runs a version of the rules compiled for the behaviours of that
+/// tick (a RuleSet), so the cell loop has no tick checks in it.
+///
+/// A tick is a list of stages (a phase of one checkerboard pass) over the awake
+/// chunks. advance() runs them a few chunks at a time until its time is up and
+/// keeps a cursor, so a tick of a huge grid can take several frames. The stages
+/// run in the same order however they're sliced, so a sliced tick gives the same
+/// state as step().
+class Simulation
+{
+public:
+	Simulation(); ///< @brief Constructor of the Simulation
+	virtual ~Simulation(); ///< @brief Destructor of the Simulation
+
+	/// @brief How a tick writes its result
+	enum Mode {
+		MODE_DOUBLE_BUFFER, ///< @brief Read the front buffer, write the back buffer, swap
+		MODE_IN_PLACE ///< @brief Write the front buffer, skip cells already written this tick
+	};
+
+	/// @brief Set how ticks write their result
+	/// @param m Mode
+	/// @return void
+	void mode(Mode m) { _mode = m; }
+	/// @brief Get how ticks write their result
+	/// @return Mode
+	Mode mode() { return _mode; }
+	/// @brief Set the number of threads a tick runs on
+	/// @param n Threads, 1 runs the serial path
+	/// @return void
+	void threads(int n);
+	/// @brief Get the number of threads a tick runs on
+	/// @return int
+	int threads() { return _pool.threads(); }
+	/// @brief Seed the random rolls of the rules
+	/// @param s Seed
+	/// @return void
+	void seed(unsigned int s) { _seed = s; }
+	/// @brief Get the seed of the random rolls
+	/// @return unsigned int
+	unsigned int seed() { return _seed; }
+	/// @brief The materials and their reactions, compile() other rules into it to change them
+	/// @return MaterialTable&
+	MaterialTable& materials() { return _materials; }
+
+	/// @brief Advance the grid by one tick, only visiting the chunks that are awake. Doesn't allocate.
+	/// The result only depends on the grid, the seed and frameCount. Finishes the tick advance()
+	/// started instead, if there is one
+	/// @param grid The level
+	/// @param frameCount Frames since the start of the game, some materials only move every n frames
+	/// @return void
+	void step(CellGrid& grid, int frameCount);
+	/// @brief Run a tick for a limited time: start one if none is in progress, then run as many of its chunks
+	/// that probably fit in the time that's left. Always starts the tick, runs a chunk or ends the tick,
+	/// so every call makes progress.
+	/// Don't change the grid in between other than with CellGrid::material(), or cancel() first
+	/// @param grid The level
+	/// @param frameCount Frames since the start of the game, only used to start a tick
+	/// @param seconds Time this call may take, less than 0 to finish the tick
+	/// @return bool true when the tick is done, false when the next call goes on with it
+	bool advance(CellGrid& grid, int frameCount, double seconds);
+	/// @brief Check if a tick was started but isn't done
+	/// @return bool
+	bool ticking() { return _ticking; }
+	/// @brief Forget the tick in progress, before the grid is loaded or resized
+	/// @param grid The level the tick runs on
+	/// @return void
+	void cancel(CellGrid& grid);
+
+	/// @brief The behaviours a version of the rules runs, bit b is Behaviour b. BEHAVIOUR_STATIC always runs
+	enum RuleSet {
+		RULES_FLOW = (1 << BEHAVIOUR_SLIDE) | (1 << BEHAVIOUR_LIQUID), ///< @brief What moves every tick
+		RULES_FALL = RULES_FLOW | (1 << BEHAVIOUR_POWDER) | (1 << BEHAVIOUR_GRASS), ///< @brief Every 2nd tick with the default materials
+		RULES_ALL = RULES_FALL | (1 << BEHAVIOUR_FIRE) | (1 << BEHAVIOUR_DISSOLVE) ///< @brief Everything
+	};
+
+private:
+	/// @brief Work out the awake chunks and the rules of a new tick
+	/// @param grid The level
+	/// @param frameCount Frames since the start of the game
+	/// @return void
+	void beginTick(CellGrid& grid, int frameCount);
+	/// @brief Merge what the threads woke and forget the tick
+	/// @param grid The level
+	/// @return void
+	void endTick(CellGrid& grid);
+	/// @brief The next estimate of a time from the last one and a new measurement
+	/// @param previous The estimate so far
+	/// @param measured The new measurement
+	/// @return double
+	static double estimate(double previous, double measured);
+	/// @brief Step a chunk with the version of the rules picked for the tick
+	/// @param grid The level
+	/// @param cells Where the rules read and write
+	/// @param cx Chunk x
+	/// @param cy Chunk y
+	/// @return void
+	template<class Cells>
+	void runChunk(CellGrid& grid, Cells& cells, int cx, int cy);
+	/// @brief Visit the active rectangle and the listed cells of a chunk
+	/// @param grid The level
+	/// @param cells Where the rules read and write
+	/// @param cx Chunk x
+	/// @param cy Chunk y
+	/// @return void
+	template<unsigned int RULES, class Cells>
+	void stepChunk(CellGrid& grid, Cells& cells, int cx, int cy);
+	/// @brief The rules for one cell, written once for both modes and every RuleSet
+	/// @param grid The level
+	/// @param cells Where the rules read and write
+	/// @param x X
+	/// @param y Y
+	/// @return void
+	template<unsigned int RULES, class Cells>
+	void stepCell(CellGrid& grid, Cells& cells, int x, int y);
+	/// @brief Worker pool job: one phase of one chunk
+	/// @param context The TickJobs
+	/// @param index Index in the batch, TickJobs::first is the first chunk of the batch in the list
+	/// @param worker Thread the job runs on
+	/// @return void
+	static void chunkJob(void* context, int index, int worker);
+
+	/// @brief What one thread needs to itself during a tick
+	struct Worker
+	{
+		std::vector<CellGrid::Rect> dirty; ///< @brief Cells this thread woke, merged into the grid after the tick
+	};
+
+	Mode _mode; ///< @brief How ticks write their result
+	unsigned int _seed; ///< @brief Seed of the random rolls
+	MaterialTable _materials; ///< @brief The materials and their reactions
+	Behaviour _behaviours[MaterialTable::MAX_MATERIALS]; ///< @brief Behaviour of every material during the current tick
+	uint32_t _skip; ///< @brief Bit m set: the current tick doesn't visit cells of material m, see visitMask()
+	RuleSet _rules; ///< @brief The version of the rules the current tick runs
+	bool _slips; ///< @brief Sliding materials may slip this tick
+	WorkerPool _pool; ///< @brief Threads for the parallel path
+	std::vector<Worker> _workers; ///< @brief One per thread
+	std::vector<int> _passes[4]; ///< @brief The awake chunks of each checkerboard pass
+	std::vector<int> _awake; ///< @brief All awake chunks
+	bool _ticking; ///< @brief A tick is in progress
+	int _frameCount; ///< @brief frameCount of the tick in progress
+	int _stage; ///< @brief Stage of the tick in progress
+	int _cursor; ///< @brief Next chunk of the stage in its chunk list
+	double _chunkSeconds[4]; ///< @brief How long a chunk of each phase takes, to stop before the time is up, see estimate()
+	double _endSeconds; ///< @brief How long endTick() takes
+};
+
+#endif /* SIMULATION_H */
@@ -0,0 +1,174 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include <cstring>
+#include "snapshot.h"
+
+/// @brief Append a number, 7 bits per byte
+static inline void putCount(std::vector<uint8_t>& out, size_t n)
+{
+	while (n >= 0x80) {
+		out.push_back(uint8_t(n | 0x80));
+		n >>= 7;
+	}
+	out.push_back(uint8_t(n));
+}
+
+/// @brief Read a number written by putCount()
+static inline size_t getCount(const uint8_t*& in)
+{
+	size_t n = 0;
+	int shift = 0;
+	while (*in & 0x80) {
+		n |= size_t(*in++ & 0x7F) << shift;
+		shift += 7;
+	}
+	n |= size_t(*in++) << shift;
+	return n;
+}
+
+SimSnapshot::SimSnapshot()
+{
+	_first = 0;
+	_count = 0;
+	_bytes = 0;
+	_budget = 4 * 1024 * 1024;
+	slots(256);
+}
+
+SimSnapshot::~SimSnapshot()
+{
+
+}
+
+void SimSnapshot::slots(int n)
+{
+	if (n < 1) {
+		n = 1;
+	}
+	_deltas.resize(n);
+	for (std::vector<uint8_t>& d : _deltas) {
+		d.clear();
+	}
+	_first = 0;
+	_count = 0;
+	_bytes = 0;
+	_newest.clear();
+}
+
+int SimSnapshot::start(const CellGrid& grid)
+{
+	slots(slots());
+	_start.assign(grid.front(), grid.front() + grid.storage());
+	return capture(grid);
+}
+
+int SimSnapshot::capture(const CellGrid& grid)
+{
+	if (_count > 0 && _newest.size() != grid.storage()) {
+		return start(grid);
+	}
+	if (_count == (int)_deltas.size()) {
+		dropOldest();
+	}
+
+	int slot = (_first + _count) % slots();
+	std::vector<uint8_t>& delta = _deltas[slot];
+	_bytes -= delta.size();
+	if (_count == 0) {
+		delta.clear(); //nothing before it
+		_newest.assign(grid.front(), grid.front() + grid.storage());
+	}
+	else {
+		encode(grid.front(), &_newest[0], _newest.size(), delta);
+		memcpy(&_newest[0], grid.front(), _newest.size());
+	}
+	_bytes += delta.size();
+	_count++;
+
+	while (_bytes > _budget && _count > 1) {
+		dropOldest();
+	}
+	return slot;
+}
+
+int SimSnapshot::rewind(CellGrid& grid)
+{
+	if (_count == 0 || _newest.size() != grid.storage()) {
+		return -1;
+	}
+	int slot = (_first + _count - 1) % slots();
+	grid.load(&_newest[0]);
+	if (_count > 1) {
+		// step the newest snapshot back to the one before it
+		apply(_deltas[slot], &_newest[0]);
+		_bytes -= _deltas[slot].size();
+		_deltas[slot].clear();
+		_count--;
+	}
+	return slot;
+}
+
+int SimSnapshot::restart(CellGrid& grid)
+{
+	if (_start.empty() || _start.size() != grid.storage()) {
+		return -1;
+	}
+	grid.load(&_start[0]);
+	return start(grid);
+}
+
+void SimSnapshot::dropOldest()
+{
+	// the next one becomes the oldest, it doesn't need its way back anymore
+	_first = (_first + 1) % slots();
+	_count--;
+	if (_count > 0) {
+		_bytes -= _deltas[_first].size();
+		_deltas[_first].clear();
+	}
+}
+
+void SimSnapshot::encode(const Material* a, const Material* b, size_t n, std::vector<uint8_t>& out)
+{
+	// pairs of (unchanged cells, changed cells) followed by the XOR of the changed ones.
+	// A changed run only ends at two unchanged cells, one isn't worth a new pair
+	out.clear();
+	size_t i = 0;
+	while (i < n) {
+		size_t same = i;
+		while (i < n && a[i] == b[i]) {
+			i++;
+		}
+		if (i == n) {
+			break;
+		}
+		size_t changed = i;
+		while (i < n && (a[i] != b[i] || (i + 1 < n && a[i + 1] != b[i + 1]))) {
+			i++;
+		}
+		putCount(out, changed - same);
+		putCount(out, i - changed);
+		for (size_t j = changed; j < i; j++) {
+			out.push_back(uint8_t(a[j] ^ b[j]));
+		}
+	}
+}
+
+void SimSnapshot::apply(const std::vector<uint8_t>& delta, Material* cells)
+{
+	const uint8_t* in = delta.data();
+	const uint8_t* end = in + delta.size();
+	Material* c = cells;
+	while (in < end) {
+		c += getCount(in);
+		size_t changed = getCount(in);
+		for (size_t j = 0; j < changed; j++) {
+			*c++ ^= *in++;
+		}
+	}
+}
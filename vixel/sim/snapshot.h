@@ -0,0 +1,97 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "cellgrid.h"
+
+/// @brief A ring of earlier states of a CellGrid, to rewind to and to restart a level from.
+///
+/// Only the newest snapshot is kept whole. Every other one is the XOR of two
+/// neighbouring snapshots, run-length encoded: between two snapshots a few
+/// ticks apart most cells didn't change, so a snapshot of a 160x90 level is a
+/// few hundred bytes instead of 16 KB. Rewinding copies the newest one back
+/// into the grid and applies its delta to step the newest one further back, so
+/// it costs one memcpy however long the ring is. When the ring is full or over
+/// its budget, the oldest snapshot goes.
+///
+/// The start of the level is kept whole on its own, so restarting doesn't have
+/// to load the level again. Only the materials are saved, not the metadata
+/// planes. What else a snapshot needs (the characters) is up to the caller:
+/// capture() and rewind() return the slot of the snapshot to keep it in.
+class SimSnapshot
+{
+public:
+	SimSnapshot(); ///< @brief Constructor of the SimSnapshot
+	virtual ~SimSnapshot(); ///< @brief Destructor of the SimSnapshot
+
+	/// @brief Set the number of snapshots the ring holds and clear it
+	/// @param n Snapshots, at least 1
+	/// @return void
+	void slots(int n);
+	/// @brief Get the number of snapshots the ring holds
+	/// @return int
+	int slots() const { return (int)_deltas.size(); }
+	/// @brief Set the most memory the deltas may use, the oldest snapshots go first to stay under it
+	/// @param bytes Budget
+	/// @return void
+	void budget(size_t bytes) { _budget = bytes; }
+	/// @brief Number of snapshots in the ring
+	/// @return int
+	int count() const { return _count; }
+	/// @brief Memory used by the snapshots, the newest one and the start of the level included
+	/// @return size_t bytes
+	size_t bytes() const { return _bytes + _newest.size() + _start.size(); }
+
+	/// @brief Clear the ring and save the grid as the start of the level and as the first snapshot
+	/// @param grid The level
+	/// @return int slot of the snapshot
+	int start(const CellGrid& grid);
+	/// @brief Save the grid as the newest snapshot. Starts over when the grid changed size
+	/// @param grid The level
+	/// @return int slot of the snapshot
+	int capture(const CellGrid& grid);
+	/// @brief Copy the newest snapshot into the grid and drop it, the oldest one stays
+	/// @param grid The level
+	/// @return int slot of the snapshot, -1 when there's none for a grid of this size
+	int rewind(CellGrid& grid);
+	/// @brief Copy the start of the level into the grid, it becomes the only snapshot
+	/// @param grid The level
+	/// @return int slot of the snapshot, -1 when there's none for a grid of this size
+	int restart(CellGrid& grid);
+
+private:
+	/// @brief Run-length encode the XOR of two states
+	/// @param a State
+	/// @param b Other state
+	/// @param n Number of cells
+	/// @param out The delta, replaced
+	/// @return void
+	static void encode(const Material* a, const Material* b, size_t n, std::vector<uint8_t>& out);
+	/// @brief XOR a delta onto a state, which turns one of the two states it was encoded from into the other
+	/// @param delta From encode()
+	/// @param cells State
+	/// @return void
+	static void apply(const std::vector<uint8_t>& delta, Material* cells);
+	/// @brief Drop the oldest snapshot
+	/// @return void
+	void dropOldest();
+
+	std::vector<std::vector<uint8_t> > _deltas; ///< @brief Per slot: the way back to the snapshot before it
+	std::vector<Material> _newest; ///< @brief The newest snapshot, whole
+	std::vector<Material> _start; ///< @brief The start of the level, whole
+	int _first; ///< @brief Slot of the oldest snapshot
+	int _count; ///< @brief Number of snapshots
+	size_t _bytes; ///< @brief Memory used by the deltas
+	size_t _budget; ///< @brief Most memory the deltas may use
+};
+
+#endif /* SNAPSHOT_H */
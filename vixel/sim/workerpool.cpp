@@ -0,0 +1,105 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include "workerpool.h"
+
+WorkerPool::WorkerPool()
+{
+	_job = nullptr;
+	_context = nullptr;
+	_count = 0;
+	_next = 0;
+	_batch = 0;
+	_busy = 0;
+	_quit = false;
+}
+
+WorkerPool::~WorkerPool()
+{
+	stop();
+}
+
+void WorkerPool::start(int threads)
+{
+	stop();
+	_quit = false;
+	for (int i = 1; i < threads; i++) {
+		_threads.push_back(std::thread(&WorkerPool::work, this, i));
+	}
+}
+
+void WorkerPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_start.notify_all();
+	for (std::thread& t : _threads) {
+		t.join();
+	}
+	_threads.clear();
+}
+
+void WorkerPool::run(Job job, void* context, int count)
+{
+	if (count <= 0) {
+		return;
+	}
+	if (_threads.empty() || count == 1) {
+		for (int i = 0; i < count; i++) {
+			job(context, i, 0);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_job = job;
+		_context = context;
+		_count = count;
+		_next.store(0);
+		_busy = (int)_threads.size();
+		_batch++;
+	}
+	_start.notify_all();
+
+	drain(0);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_done.wait(lock, [this] { return _busy == 0; });
+}
+
+void WorkerPool::work(int worker)
+{
+	unsigned int seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_start.wait(lock, [this, seen] { return _quit || _batch != seen; });
+			if (_quit) {
+				return;
+			}
+			seen = _batch;
+		}
+
+		drain(worker);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (--_busy == 0) {
+			_done.notify_one();
+		}
+	}
+}
+
+void WorkerPool::drain(int worker)
+{
+	int i;
+	while ((i = _next.fetch_add(1)) < _count) {
+		_job(_context, i, worker);
+	}
+}
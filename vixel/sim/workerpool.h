@@ -0,0 +1,70 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/// @brief A fixed set of threads that run a batch of jobs and wait for the next one.
+///
+/// The thread calling run() works along, so a pool of n threads starts n - 1.
+/// A job is a plain function pointer plus context, so a batch never allocates.
+class WorkerPool
+{
+public:
+	WorkerPool(); ///< @brief Constructor of the WorkerPool
+	virtual ~WorkerPool(); ///< @brief Destructor of the WorkerPool, stops the threads
+
+	/// @brief A job: runs item 'index' of a batch on thread 'worker' (0 is the caller)
+	typedef void (*Job)(void* context, int index, int worker);
+
+	/// @brief Stop the current threads and start new ones
+	/// @param threads Number of threads including the caller, 1 runs everything on the caller
+	/// @return void
+	void start(int threads);
+	/// @brief Stop all threads
+	/// @return void
+	void stop();
+	/// @brief Number of threads including the caller
+	int threads() const { return (int)_threads.size() + 1; }
+
+	/// @brief Run job(context, i, worker) for every i in [0, count) and wait until all are done
+	/// @param job Job
+	/// @param context Passed to every job
+	/// @param count Number of items
+	/// @return void
+	void run(Job job, void* context, int count);
+
+private:
+	/// @brief Thread main loop: wait for a batch, help drain it, repeat
+	/// @param worker Index of the thread
+	/// @return void
+	void work(int worker);
+	/// @brief Take items from the current batch until there are none left
+	/// @param worker Index of the thread
+	/// @return void
+	void drain(int worker);
+
+	std::vector<std::thread> _threads; ///< @brief The threads besides the caller
+	std::mutex _mutex; ///< @brief Guards the batch and the counters below
+	std::condition_variable _start; ///< @brief Signals a new batch (or quit)
+	std::condition_variable _done; ///< @brief Signals the last thread finished the batch
+	Job _job; ///< @brief Job of the current batch
+	void* _context; ///< @brief Context of the current batch
+	int _count; ///< @brief Number of items in the current batch
+	std::atomic<int> _next; ///< @brief Next item to take
+	unsigned int _batch; ///< @brief Batch counter, so threads see a new batch
+	int _busy; ///< @brief Threads still working on the current batch
+	bool _quit; ///< @brief Tells the threads to stop
+};
+
+#endif /* WORKERPOOL_H */
@@ -0,0 +1,515 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include "world.h"
+
+World::World()
+{
+	//what a character's probe makes of every material
+	for (int m = 0; m < 256; m++) {
+		_probe[m] = 0;
+		if (m != 0 && m != 10) {
+			_probe[m] |= PROBE_BLOCKS;
+		}
+		if (m == 5) {
+			_probe[m] |= PROBE_LAVA;
+		}
+		if (m == 6) {
+			_probe[m] |= PROBE_WATER;
+		}
+		if (m == 11) {
+			_probe[m] |= PROBE_HOME;
+		}
+	}
+}
+
+World::~World()
+{
+
+}
+
+void World::load(const uint8_t* pixels, int bytesPerPixel, const uint8_t (*palette)[3], int paletteSize)
+{
+	characters.clear();
+	homes.clear();
+
+	const int w = cells.width();
+	const int h = cells.height();
+	std::vector<int> result = std::vector<int>(w * h, 0);
+
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			const uint8_t* p = pixels + (y * w + x) * bytesPerPixel;
+			int r = p[0];
+			int g = p[1];
+			int b = p[2];
+			//check if there a character via the red channel, then use green and blue to change the size of the character
+			if (r == 1) {
+				characters.add(x, y, g, b);
+			}
+			//check if there a home via the red channel, then use green and blue to change the size of the home
+			else if (r == 222) {
+				Home home(x, y);
+				home.spriteW = g;
+				home.spriteH = b;
+				homes.push_back(home);
+			}
+			//loop over materials to find the right one
+			else {
+				for (int i = 0; i < paletteSize; i++)
+				{
+					//compare color
+					if (r == palette[i][0] && g == palette[i][1] && b == palette[i][2]) {
+						result[y * w + x] = i; //row by row, CellGrid::assign() tiles it
+					}
+				}
+			}
+		}
+	}
+	cells.assign(result);
+	placeCharacters();
+	watchHomes();
+}
+
+void World::placeCharacters()
+{
+	cells.clearOccupied();
+	for (size_t i = 0; i < characters.size(); i++) {
+		if (!characters.home(i)) {
+			occupy(characters.x[i], characters.y[i], characters.width[i], characters.height[i], true);
+		}
+	}
+}
+
+void World::tick(int frameCount)
+{
+	updateField(frameCount);
+	updateHomes();
+	updateCharacters(frameCount);
+}
+
+void World::updateField(int frameCount)
+{
+	simulation.step(cells, frameCount);
+}
+
+bool World::updateField(int frameCount, double seconds)
+{
+	return simulation.advance(cells, frameCount, seconds);
+}
+
+bool World::follow(int x, int y)
+{
+	int dcx;
+	int dcy;
+	if (simulation.ticking() || !pager.follow(cells, x, y, dcx, dcy)) {
+		return false;
+	}
+	const int dx = dcx * CellGrid::CHUNK_SIZE;
+	const int dy = dcy * CellGrid::CHUNK_SIZE;
+	characters.move(-dx, -dy);
+	for (Home& h : homes) {
+		h.position.x -= dx;
+		h.position.y -= dy;
+	}
+	//the occupied cells scrolled along, but the ones of a character that was outside the cells are gone,
+	//and the homes watch other chunks now
+	placeCharacters();
+	watchHomes();
+	return true;
+}
+
+void World::updateHomes()
+{
+	if (_perimeterStart.size() != homes.size() || _watchFirst.size() != size_t(cells.chunkCount())) {
+		watchHomes(); //the homes were replaced without it
+	}
+
+	//only the cells that changed since the last time: the wood around a home and what moved into it
+	for (int c : _watchedChunks) {
+		CellGrid::Rect changed = cells.changes(c % cells.chunksX(), c / cells.chunksX());
+		if (changed.empty()) {
+			continue;
+		}
+		for (int w = _watchFirst[c]; w != -1; w = _watches[w].next) {
+			Home& h = homes[_watches[w].home];
+			uint8_t* perimeter = &_perimeter[_perimeterStart[_watches[w].home]];
+			//the columns and rows of the home the change covers
+			const int left = h.position.x - 1;
+			const int right = h.position.x + h.spriteW;
+			const int bottom = h.position.y - 1;
+			const int top = h.position.y + h.spriteH;
+			const int x0 = std::max(changed.x0, h.position.x);
+			const int x1 = std::min(changed.x1, right - 1);
+			const int y0 = std::max(changed.y0, h.position.y);
+			const int y1 = std::min(changed.y1, top - 1);
+
+			//the four sides of the perimeter, each only where the change crosses it
+			if (x0 <= x1) {
+				if (changed.y0 <= top && top <= changed.y1) {
+					for (int x = x0; x <= x1; x++) {
+						recount(h, perimeter[x - h.position.x], x, top, false);
+					}
+				}
+				if (changed.y0 <= bottom && bottom <= changed.y1) {
+					for (int x = x0; x <= x1; x++) {
+						recount(h, perimeter[h.spriteW + x - h.position.x], x, bottom, true);
+					}
+				}
+			}
+			if (y0 <= y1) {
+				if (changed.x0 <= left && left <= changed.x1) {
+					for (int y = y0; y <= y1; y++) {
+						recount(h, perimeter[2 * h.spriteW + y - h.position.y], left, y, false);
+					}
+				}
+				if (changed.x0 <= right && right <= changed.x1) {
+					for (int y = y0; y <= y1; y++) {
+						recount(h, perimeter[2 * h.spriteW + h.spriteH + y - h.position.y], right, y, false);
+					}
+				}
+				//something moved into the home
+				for (int y = y0; y <= y1; y++) {
+					for (int x = x0; x <= x1; x++) {
+						drawHome(cells.id(x, y), h.active);
+					}
+				}
+			}
+			bool active = h.wood >= (h.spriteH + h.spriteW * 2);
+			if (active != h.active) {
+				h.active = active;
+				drawHome(h, active);
+			}
+		}
+	}
+	cells.clearChanges();
+}
+
+void World::watchHomes()
+{
+	const int chunksX = cells.chunksX();
+	_watchFirst.assign(cells.chunkCount(), -1);
+	_watches.clear();
+	_watchedChunks.clear();
+	_perimeterStart.resize(homes.size());
+	_perimeter.clear();
+	cells.trackChanges(!homes.empty());
+
+	for (size_t i = 0; i < homes.size(); i++) {
+		Home& h = homes[i];
+
+		//count the wood around the home, the row above and below first, then the sides
+		_perimeterStart[i] = int(_perimeter.size());
+		for (int x = 0; x < h.spriteW; x++) {
+			_perimeter.push_back(wood(h.position.x + x, h.position.y + h.spriteH, false));
+		}
+		for (int x = 0; x < h.spriteW; x++) {
+			_perimeter.push_back(wood(h.position.x + x, h.position.y - 1, true));
+		}
+		for (int y = 0; y < h.spriteH; y++) {
+			_perimeter.push_back(wood(h.position.x - 1, h.position.y + y, false));
+		}
+		for (int y = 0; y < h.spriteH; y++) {
+			_perimeter.push_back(wood(h.position.x + h.spriteW, h.position.y + y, false));
+		}
+		h.wood = 0;
+		for (size_t n = _perimeterStart[i]; n < _perimeter.size(); n++) {
+			h.wood += _perimeter[n];
+		}
+		h.active = h.wood >= (h.spriteH + h.spriteW * 2);
+		drawHome(h, h.active);
+
+		//the chunks the home and its perimeter are in get it on their list
+		const int x0 = std::max(h.position.x - 1, 0);
+		const int y0 = std::max(h.position.y - 1, 0);
+		const int x1 = std::min(h.position.x + h.spriteW, cells.width() - 1);
+		const int y1 = std::min(h.position.y + h.spriteH, cells.height() - 1);
+		if (x0 > x1 || y0 > y1) {
+			continue;
+		}
+		for (int cy = y0 / CellGrid::CHUNK_SIZE; cy <= y1 / CellGrid::CHUNK_SIZE; cy++) {
+			for (int cx = x0 / CellGrid::CHUNK_SIZE; cx <= x1 / CellGrid::CHUNK_SIZE; cx++) {
+				int c = cy * chunksX + cx;
+				if (_watchFirst[c] == -1) {
+					_watchedChunks.push_back(c);
+				}
+				HomeWatch watch = { int(i), _watchFirst[c] };
+				_watchFirst[c] = int(_watches.size());
+				_watches.push_back(watch);
+			}
+		}
+	}
+}
+
+void World::drawHome(const Home& h, bool active)
+{
+	for (int x = 0; x < h.spriteW; x++) //draw the home
+	{
+		for (int y = 0; y < h.spriteH; y++)
+		{
+			int pos = cells.id(h.position.x + x, h.position.y + y);
+			if (pos != -1) {
+				drawHome(pos, active);
+			}
+		}
+	}
+}
+
+void World::drawHome(int pos, bool active)
+{
+	if (cells[pos] != 2 && cells[pos] != 4) {
+		if (active) {
+			cells.material(pos, 11);
+		}
+		else {
+			cells.material(pos, 10);
+		}
+	}
+}
+
+void World::updateCharacters(int frameCount)
+{
+	sounds.clear();
+
+	//which updates run this frame, the same for every character
+	const bool walkFrame = frameCount % 10 == 0;
+	const bool gravityFrame = frameCount % 4 == 0;
+	const bool breathFrame = frameCount % 6 == 0;
+
+	Characters& c = characters;
+	const size_t count = c.size();
+	_oldX = c.x;
+	_oldY = c.y;
+	_ticked.resize(count);
+	_water.assign(count, 0);
+	_homeCells.assign(count, 0);
+	_probed.resize(count);
+	_lava.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		_ticked[i] = c.awake(i);
+	}
+
+	if (walkFrame) {
+		//fall audio
+		for (size_t i = 0; i < count; i++) {
+			if (_ticked[i] && c.airTime[i] == 6) {
+				sound(SOUND_FALL, int(i));
+			}
+		}
+		//probe the column in front of every character: the highest collision, water, home and lava
+		for (size_t i = 0; i < count; i++) {
+			if (!_ticked[i]) {
+				continue;
+			}
+			const int px = (c.direction[i] == 1) ? c.x[i] + c.width[i] : c.x[i] - 1;
+			int highest = -1;
+			int found = 0;
+			for (int y = 0; y < c.height[i]; y++) {
+				int p = probe(px, c.y[i] + y);
+				found |= p;
+				_water[i] += (p & PROBE_WATER) != 0;
+				_homeCells[i] += (p & PROBE_HOME) != 0;
+				if (p & PROBE_BLOCKS) {
+					highest = y;
+				}
+			}
+			_probed[i] = highest;
+			_lava[i] = (found & PROBE_LAVA) != 0;
+		}
+		//walk, walk up a slope or turn around
+		for (size_t i = 0; i < count; i++) {
+			if (!_ticked[i]) {
+				continue;
+			}
+			if (_lava[i]) { //die in lava
+				c.die(i);
+			}
+			const int highest = _probed[i];
+			if (highest == -1 && c.awake(i)) { //walking
+				c.walk(i);
+				c.breath[i] = 16;
+			}
+			else if (highest == 0 && c.height[i] > 1 && c.awake(i)) { //walk up one block slope
+				c.y[i] += 1;
+				c.walk(i);
+			}
+			else if (highest == 1 && c.height[i] > 2 && c.awake(i)) { //walk up two block slope
+				c.y[i] += 2;
+				c.walk(i);
+			}
+			else { //turn around
+				c.turn(i);
+			}
+		}
+	}
+
+	if (gravityFrame) {
+		//probe the row below every character, where it is after walking
+		for (size_t i = 0; i < count; i++) {
+			if (!_ticked[i] || !c.awake(i)) {
+				_probed[i] = -1;
+				continue;
+			}
+			int floor = 0;
+			int found = 0;
+			for (int x = 0; x < c.width[i]; x++) {
+				int p = probe(c.x[i] + x, c.y[i] - 1);
+				found |= p;
+				_water[i] += (p & PROBE_WATER) != 0;
+				floor += (p & (PROBE_BLOCKS | PROBE_WATER | PROBE_HOME)) == PROBE_BLOCKS;
+			}
+			_probed[i] = floor;
+			_lava[i] = uint8_t(found & (PROBE_LAVA | PROBE_WATER));
+		}
+		//fall, land or die
+		for (size_t i = 0; i < count; i++) {
+			if (_probed[i] < 0) {
+				continue;
+			}
+			if (_lava[i] & PROBE_LAVA) { //die in lava
+				c.die(i);
+				continue;
+			}
+			if (_lava[i] & PROBE_WATER) {
+				c.airTime[i] = 0;
+			}
+			if (_probed[i] == 0) { //fall if there are no collisions below the character
+				c.fall(i);
+			}
+			else if (c.airTime[i] > 40) { //kill character when falling for too long and hits the ground
+				sound(SOUND_STOP, int(i), c.fallSound[i]);
+				sound(SOUND_LAND_DIE, int(i));
+				c.die(i);
+			}
+			else {
+				c.airTime[i] = 0;
+			}
+		}
+	}
+
+	if (breathFrame) {
+		//check if the character is submerged in water and remove some breath
+		for (size_t i = 0; i < count; i++) {
+			if (!_ticked[i] || _water[i] < c.height[i]) {
+				continue;
+			}
+			if (c.breath[i] == 7) { //play drowning sound
+				sound(SOUND_DROWNING, int(i));
+			}
+			c.breath[i]--;
+			if (c.breath[i] <= 0) { //drown.
+				sound(SOUND_DROWN, int(i));
+				c.die(i);
+			}
+		}
+	}
+
+	//home check
+	for (size_t i = 0; i < count; i++) {
+		if (_homeCells[i] >= c.height[i]) {
+			sound(SOUND_HOME, int(i));
+			c.flags[i] = (c.flags[i] & ~CHARACTER_AWAKE) | CHARACTER_HOME;
+		}
+	}
+	//the characters only moved in the occupancy plane, the cells stay the same: clear every
+	//character that moved where it was, then set every one where it is, so they don't clear each other
+	for (size_t i = 0; i < count; i++) {
+		if (_ticked[i] && (c.x[i] != _oldX[i] || c.y[i] != _oldY[i] || c.home(i))) {
+			occupy(_oldX[i], _oldY[i], c.width[i], c.height[i], false);
+		}
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (!c.home(i)) {
+			occupy(c.x[i], c.y[i], c.width[i], c.height[i], true);
+		}
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (_ticked[i] && (c.x[i] != _oldX[i] || c.y[i] != _oldY[i] || c.home(i))) {
+			vacate(_oldX[i], _oldY[i], c.width[i], c.height[i]);
+		}
+	}
+}
+
+void World::occupy(int x, int y, int w, int h, bool on)
+{
+	CellGrid::Rect area = { x, y, x + w - 1, y + h - 1 };
+	cells.occupy(area, on);
+}
+
+void World::vacate(int x, int y, int w, int h)
+{
+	CellGrid::Rect area = { std::max(x, 0), std::max(y, 0), std::min(x + w, cells.width()) - 1, std::min(y + h, cells.height()) - 1 };
+	if (area.empty() || area.y0 > area.y1) {
+		return;
+	}
+	//what may fall in from above or flow in from the sides, the floor stays where it is
+	bool around = false;
+	for (int dx = -1; dx <= w && !around; dx++) {
+		int id = cells.id(x + dx, y + h);
+		around = id != -1 && cells[id] != 0;
+	}
+	for (int dy = 0; dy < h && !around; dy++) {
+		int left = cells.id(x - 1, y + dy);
+		int right = cells.id(x + w, y + dy);
+		around = (left != -1 && cells[left] != 0) || (right != -1 && cells[right] != 0);
+	}
+	if (around) {
+		cells.wake(cells.grow(area), cells.dirtyRects());
+	}
+}
+
+void World::sound(WorldSoundId id, int character, int voice)
+{
+	WorldSound s;
+	s.id = id;
+	s.character = character;
+	s.x = characters.x[character];
+	s.y = characters.y[character];
+	s.voice = voice;
+	sounds.push_back(s);
+}
+
+bool readLevelImage(const std::string& path, int& width, int& height, int& bytesPerPixel, std::vector<uint8_t>& pixels)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in.is_open()) {
+		return false;
+	}
+	std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (file.size() < 18 || file[1] != 0 || file[2] != 2) { //no color map, uncompressed true color
+		return false;
+	}
+	width = file[12] | (file[13] << 8);
+	height = file[14] | (file[15] << 8);
+	bytesPerPixel = file[16] / 8;
+	bool topDown = (file[17] & 0x20) != 0;
+	size_t start = 18 + file[0];
+	size_t bytes = size_t(width) * height * bytesPerPixel;
+	if ((bytesPerPixel != 3 && bytesPerPixel != 4) || file.size() < start + bytes) {
+		return false;
+	}
+
+	//BGR(A) to RGB(A), bottom row first
+	pixels.resize(bytes);
+	const size_t row = size_t(width) * bytesPerPixel;
+	for (int y = 0; y < height; y++) {
+		const uint8_t* src = &file[start + (topDown ? height - 1 - y : y) * row];
+		uint8_t* dst = &pixels[y * row];
+		for (size_t i = 0; i < row; i += bytesPerPixel) {
+			dst[i + 0] = src[i + 2];
+			dst[i + 1] = src[i + 1];
+			dst[i + 2] = src[i + 0];
+			if (bytesPerPixel == 4) {
+				dst[i + 3] = src[i + 3];
+			}
+		}
+	}
+	return true;
+}
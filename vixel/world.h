@@ -0,0 +1,205 @@
+/**
+ * This file is part of the game Vixel in the RT2D framework.
+ *
+ * - Copyright 2019 Lucy Jongebloed
+ *     - Initial commit
+ */
+
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "characters.h"
+#include "home.h"
+#include "sim/cellgrid.h"
+#include "sim/simulation.h"
+#include "sim/chunkpager.h"
+
+/// @brief The sounds of the World, the same order as Game::sfx
+enum WorldSoundId {
+	SOUND_STOP = -1, ///< @brief Stop a voice that plays
+	SOUND_LAND_DIE = 0, ///< @brief A character fell too far
+	SOUND_FALL = 1, ///< @brief A character started falling
+	SOUND_DROWNING = 2, ///< @brief A character is running out of breath
+	SOUND_DROWN = 3, ///< @brief A character drowned
+	SOUND_HOME = 4 ///< @brief A character is home
+};
+
+/// @brief A sound for something that happened during a tick
+struct WorldSound
+{
+	WorldSoundId id; ///< @brief What to play
+	int character; ///< @brief Index of the character it's about
+	int x; ///< @brief Where, x
+	int y; ///< @brief Where, y
+	int voice; ///< @brief The voice to stop, for SOUND_STOP
+};
+
+/// @brief A level without a window: the cells, the characters and the homes, and what moves them.
+///
+/// The Game draws the World and plays its sounds, vixel_bench runs it headless.
+/// The characters aren't cells: they stand in the occupancy plane of the cells
+/// (CellGrid::occupied()), the simulation runs into them and the Game draws them on top.
+/// A tick is updateField(), updateHomes() and updateCharacters(), in that order.
+class World
+{
+public:
+	World(); ///< @brief Constructor of the World
+	virtual ~World(); ///< @brief Destructor of the World
+
+	CellGrid cells; ///< @brief All the pixels in the level
+	Simulation simulation; ///< @brief The rules that update the pixels
+	Characters characters; ///< @brief All the characters in the level
+	std::vector<Home> homes; ///< @brief All the homes in the level
+	std::vector<WorldSound> sounds; ///< @brief What to play for the last updateCharacters()
+	ChunkPager pager; ///< @brief The rest of the world when it's bigger than the cells, see follow()
+
+	/// @brief Build the level from an image: the colors of the materials become cells,
+	/// red 1 is a character and red 222 a home, green and blue their size
+	/// @param pixels RGB(A) pixels, row by row from the bottom, the size of the grid
+	/// @param bytesPerPixel 3 or 4
+	/// @param palette r, g, b of every material id
+	/// @param paletteSize Number of materials
+	/// @return void
+	void load(const uint8_t* pixels, int bytesPerPixel, const uint8_t (*palette)[3], int paletteSize);
+
+	/// @brief Run one tick of the simulation
+	/// @param frameCount Frames since the start of the game
+	/// @return void
+	void updateField(int frameCount);
+	/// @brief Run the simulation for a limited time, a tick of a big level can take several calls.
+	/// The cells keep the last whole tick until it's done, apart from the ones being moved
+	/// @param frameCount Frames since the start of the game, only used to start a tick
+	/// @param seconds Time this call may take
+	/// @return bool true when the tick is done, then updateHomes() and updateCharacters() can go on
+	bool updateField(int frameCount, double seconds);
+	/// @brief Update all the homes: check if there's enough wood around the home. Only looks at
+	/// the cells that changed since the last time, a home is drawn again when it turns on or off
+	/// @return void
+	void updateHomes();
+	/// @brief Update the position of all the characters and check if they need to die
+	/// @param frameCount Frames since the start of the game
+	/// @return void
+	void updateCharacters(int frameCount);
+	/// @brief Keep a position in the middle of the cells when the world is bigger than them (the pager is open).
+	/// The characters and homes move along, their positions are in cells. Waits while a tick is in progress
+	/// @param x World x
+	/// @param y World y
+	/// @return bool true when the cells moved
+	bool follow(int x, int y);
+	/// @brief updateField(), updateHomes() and updateCharacters()
+	/// @param frameCount Frames since the start of the game
+	/// @return void
+	void tick(int frameCount);
+	/// @brief Put the characters in the occupancy plane of the cells again, after they were
+	/// replaced (a snapshot) or the cells were. updateCharacters() keeps it up to date
+	/// @return void
+	void placeCharacters();
+	/// @brief Count the wood around every home again and draw it, after the homes or the
+	/// cells were replaced. updateHomes() keeps the counts up to date from there
+	/// @return void
+	void watchHomes();
+
+private:
+	/// @brief What a probe of a character makes of a cell, see probe()
+	enum ProbeBit {
+		PROBE_BLOCKS = 1, ///< @brief A character can't walk into it (water and homes too, lava, the edge)
+		PROBE_WATER = 2, ///< @brief Water
+		PROBE_HOME = 4, ///< @brief An active home
+		PROBE_LAVA = 8 ///< @brief Lava
+	};
+	/// @brief Look a cell up for a character
+	/// @param x X
+	/// @param y Y
+	/// @return int ProbeBit bits, PROBE_BLOCKS outside the grid and where another character is
+	inline int probe(int x, int y) const {
+		int id = cells.id(x, y);
+		return (id < 0 || cells.occupied(id)) ? PROBE_BLOCKS : _probe[cells[id]];
+	}
+	/// @brief Set or clear the occupied cells of a character
+	/// @param x Left column
+	/// @param y Bottom row
+	/// @param w Width
+	/// @param h Height
+	/// @param on Set or clear
+	/// @return void
+	void occupy(int x, int y, int w, int h, bool on);
+	/// @brief Wake the cells a character left, when there's something above or beside them that
+	/// may move in. A character walking through air doesn't wake anything
+	/// @param x Left column
+	/// @param y Bottom row
+	/// @param w Width
+	/// @param h Height
+	/// @return void
+	void vacate(int x, int y, int w, int h);
+	/// @brief A home that watches the cells of a chunk, an entry of a list per chunk
+	struct HomeWatch
+	{
+		int home; ///< @brief Index of the home
+		int next; ///< @brief Next entry of the chunk, -1 at the end
+	};
+	/// @brief Check if a cell around a home counts as wood. Below the grid does
+	/// @param x X
+	/// @param y Y
+	/// @param below The cell is under the home
+	/// @return bool
+	inline bool wood(int x, int y, bool below) const {
+		int id = cells.id(x, y);
+		return (id == -1) ? below : cells[id] == 2;
+	}
+	/// @brief Count a cell around a home again if it turned into wood or stopped being wood
+	/// @param h Home
+	/// @param counted The cell in _perimeter
+	/// @param x X
+	/// @param y Y
+	/// @param below The cell is under the home
+	/// @return void
+	inline void recount(Home& h, uint8_t& counted, int x, int y, bool below) {
+		uint8_t now = wood(x, y, below);
+		h.wood += now - counted;
+		counted = now;
+	}
+	/// @brief Draw all pixels of a home
+	/// @param h Home
+	/// @param active State of the home
+	/// @return void
+	void drawHome(const Home& h, bool active);
+	/// @brief Draw one pixel of a home, unless there's wood or fire
+	/// @param pos Index of the cell
+	/// @param active State of the home
+	/// @return void
+	void drawHome(int pos, bool active);
+	/// @brief Queue a sound for the Game
+	/// @param id Sound
+	/// @param character Index of the character
+	/// @param voice Voice to stop, for SOUND_STOP
+	/// @return void
+	void sound(WorldSoundId id, int character, int voice = -1);
+
+	uint8_t _probe[256]; ///< @brief ProbeBit bits of every material
+	std::vector<int> _oldX; ///< @brief Where the characters were at the start of updateCharacters(), x
+	std::vector<int> _oldY; ///< @brief Where the characters were at the start of updateCharacters(), y
+	std::vector<uint8_t> _ticked; ///< @brief The characters that were awake at the start of updateCharacters()
+	std::vector<int> _probed; ///< @brief Result of the last probe of every character: highest collision, or floor cells
+	std::vector<uint8_t> _lava; ///< @brief What else the last probe of every character found
+	std::vector<int> _water; ///< @brief Water cells the probes of every character found
+	std::vector<int> _homeCells; ///< @brief Home cells in front of every character
+	std::vector<int> _watchFirst; ///< @brief First HomeWatch of every chunk, -1 when no home is near it
+	std::vector<HomeWatch> _watches; ///< @brief The lists of homes per chunk
+	std::vector<int> _watchedChunks; ///< @brief The chunks with a list
+	std::vector<int> _perimeterStart; ///< @brief Where the perimeter of every home starts in _perimeter
+	std::vector<uint8_t> _perimeter; ///< @brief 1 for every cell around a home that counted as wood: the row above, the row below, the column left and the column right of it
+};
+
+/// @brief Read an uncompressed true color TGA, without a window
+/// @param path File
+/// @param width Width out
+/// @param height Height out
+/// @param bytesPerPixel 3 or 4 out
+/// @param pixels RGB(A) out, row by row from the bottom
+/// @return bool false when the file can't be read or isn't an uncompressed true color TGA
+bool readLevelImage(const std::string& path, int& width, int& height, int& bytesPerPixel, std::vector<uint8_t>& pixels);
+
+#endif /* WORLD_H */